@@ -0,0 +1,331 @@
+#include "Batch.h"
+#include "MeshCache.h"
+#include "Parallel.h"
+#include "PlyReader.h"
+#include "json.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+std::string resolvePath(const std::filesystem::path& base, const std::string& path) {
+    std::filesystem::path p(path);
+    return p.is_relative() ? (base / p).string() : path;
+}
+
+PoseJob parseJob(const nlohmann::json& node, const std::filesystem::path& base, size_t index) {
+    std::string name = "job " + std::to_string(index);
+    PoseJob job;
+    job.image = resolvePath(base, node.at("image").get<std::string>());
+    job.camera = node.value("camera", std::string());
+    if (node.contains("width") && node.contains("height")) {
+        job.imageSize = cv::Size(node.at("width").get<int>(), node.at("height").get<int>());
+    }
+
+    for (const auto& point : node.at("points2d")) {
+        if (point.size() != 2) {
+            CV_Error(cv::Error::StsParseError, name + ": un point 2D doit avoir 2 coordonnes");
+        }
+        job.imagePoints.push_back(cv::Point2f(point[0].get<float>(), point[1].get<float>()));
+    }
+    if (node.contains("points3d")) {
+        for (const auto& point : node.at("points3d")) {
+            if (point.size() != 3) {
+                CV_Error(cv::Error::StsParseError, name + ": un point 3D doit avoir 3 coordonnes");
+            }
+            job.objectPoints.push_back(cv::Point3f(point[0].get<float>(), point[1].get<float>(), point[2].get<float>()));
+        }
+    }
+    else if (node.contains("vertices")) {
+        job.vertexIndices = node.at("vertices").get<std::vector<int64_t>>();
+    }
+    else {
+        CV_Error(cv::Error::StsParseError, name + ": \"points3d\" ou \"vertices\" manquant");
+    }
+
+    if (node.contains("confidences")) {
+        job.confidences = node.at("confidences").get<std::vector<float>>();
+        if (job.confidences.size() != job.imagePoints.size()) {
+            CV_Error(cv::Error::StsUnmatchedSizes, name + ": une confiance par correspondance est attendue");
+        }
+    }
+
+    size_t objectCount = job.vertexIndices.empty() ? job.objectPoints.size() : job.vertexIndices.size();
+    if (objectCount != job.imagePoints.size()) {
+        CV_Error(cv::Error::StsUnmatchedSizes, name + ": nombres de points 2D et 3D diffrents");
+    }
+    return job;
+}
+
+nlohmann::json matToJson(const cv::Mat& m) {
+    cv::Mat values;
+    m.convertTo(values, CV_64F);
+    return std::vector<double>(values.ptr<double>(), values.ptr<double>() + values.total());
+}
+
+} // namespace
+
+BatchManifest BatchManifest::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        CV_Error(cv::Error::StsError, "Impossible d'ouvrir le manifeste " + path);
+    }
+
+    std::filesystem::path base = std::filesystem::path(path).parent_path();
+    BatchManifest manifest;
+    try {
+        nlohmann::json root = nlohmann::json::parse(in);
+        if (root.contains("mesh")) {
+            manifest.mesh = resolvePath(base, root.at("mesh").get<std::string>());
+        }
+        if (root.contains("intrinsics")) {
+            manifest.intrinsics = resolvePath(base, root.at("intrinsics").get<std::string>());
+        }
+        manifest.output = resolvePath(base, root.value("output", std::string("poses.json")));
+        manifest.threads = root.value("threads", 0);
+        if (root.contains("ransac")) {
+            const nlohmann::json& ransac = root.at("ransac");
+            manifest.ransac = true;
+            manifest.ransacParams.reprojectionThreshold = ransac.value("threshold", manifest.ransacParams.reprojectionThreshold);
+            manifest.ransacParams.confidence = ransac.value("confidence", manifest.ransacParams.confidence);
+            manifest.ransacParams.maxIterations = ransac.value("iterations", manifest.ransacParams.maxIterations);
+            manifest.ransacParams.seed = ransac.value("seed", manifest.ransacParams.seed);
+            manifest.ransacParams.parallel = false;    // les jobs sont dj rpartis sur les threads
+        }
+        const nlohmann::json& jobs = root.at("jobs");
+        manifest.jobs.reserve(jobs.size());
+        for (size_t i = 0; i < jobs.size(); i++) {
+            manifest.jobs.push_back(parseJob(jobs[i], base, i));
+        }
+    }
+    catch (const nlohmann::json::exception& e) {
+        CV_Error(cv::Error::StsParseError, "Manifeste " + path + " invalide: " + e.what());
+    }
+    return manifest;
+}
+
+void resolveVertexIndices(PoseJob& job, const VertexView& vertices, const uint32_t* vertexRemap,
+    size_t sourceVertexCount) {
+    size_t indexCount = vertexRemap ? sourceVertexCount : vertices.size();
+    job.objectPoints.clear();
+    job.objectPoints.reserve(job.vertexIndices.size());
+    for (int64_t index : job.vertexIndices) {
+        if (index < 0 || (uint64_t)index >= indexCount) {
+            CV_Error(cv::Error::StsOutOfRange, "Indice de sommet hors du maillage: " + std::to_string(index));
+        }
+        job.objectPoints.push_back(vertices[vertexRemap ? vertexRemap[index] : (size_t)index]);
+    }
+    job.vertexIndices.clear();
+}
+
+PoseResult solvePose(const PoseJob& job, const CameraIntrinsics& intrinsics, const RansacPnPParams* ransac,
+    PoseScratch* scratch) {
+    auto start = std::chrono::steady_clock::now();
+    PoseResult result;
+    if (job.objectPoints.size() < 4) {
+        result.error = "au moins 4 correspondances sont ncessaires";
+        return result;
+    }
+
+    // K dans le tampon du thread: allou au premier job seulement
+    PoseScratch localScratch;
+    PoseScratch& buffers = scratch ? *scratch : localScratch;
+    cv::Mat(3, 3, CV_64F, const_cast<double*>(intrinsics.K.val)).copyTo(buffers.cameraMatrix);
+    const cv::Mat& cameraMatrix = buffers.cameraMatrix;
+    if (ransac) {
+        RansacPnPResult robust = solvePnPRansacParallel(job.objectPoints, job.imagePoints, cameraMatrix,
+            intrinsics.distCoeffs, *ransac, job.confidences);
+        result.success = robust.success;
+        result.rvec = robust.rvec;
+        result.tvec = robust.tvec;
+        result.inlierMask = robust.inlierMask;
+    }
+    else {
+        // Pose initiale EPnP (les correspondances du job sont passes sans
+        // copie, mais cv::solvePnP alloue ses propres tampons  chaque appel),
+        // puis raffinement LM dans les tampons du thread (au lieu du LM de
+        // SOLVEPNP_ITERATIVE)
+        result.success = cv::solvePnP(job.objectPoints, job.imagePoints, cameraMatrix, intrinsics.distCoeffs,
+            result.rvec, result.tvec, false, cv::SOLVEPNP_EPNP);
+        if (result.success) {
+            refinePose(job.objectPoints, job.imagePoints, cameraMatrix, intrinsics.distCoeffs, result.rvec, result.tvec,
+                buffers.refiner);
+        }
+    }
+    if (!result.success) {
+        result.error = ransac ? "pas assez de correspondances cohrentes" : "chec de solvePnP";
+        return result;
+    }
+
+    std::vector<cv::Point2f>& projected = buffers.projected;
+    cv::projectPoints(job.objectPoints, result.rvec, result.tvec, cameraMatrix, intrinsics.distCoeffs, projected);
+    double squaredError = 0.0;
+    size_t used = 0;
+    for (size_t i = 0; i < projected.size(); i++) {
+        if (result.inlierMask.empty() || result.inlierMask[i]) {
+            cv::Point2f d = projected[i] - job.imagePoints[i];
+            squaredError += d.x * d.x + d.y * d.y;
+            used++;
+        }
+    }
+    result.rmsError = std::sqrt(squaredError / used);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<PoseResult> solvePoses(const std::vector<PoseJob>& jobs, const std::vector<CameraIntrinsics>& intrinsics,
+    const RansacPnPParams* ransac, int threadCount) {
+    CV_Assert(intrinsics.size() == 1 || intrinsics.size() == jobs.size());
+    if (threadCount <= 0) {
+        threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Les jobs occupent dj tous les threads: RANSAC reste squentiel dans chaque job
+    RansacPnPParams sequentialRansac;
+    if (ransac) {
+        sequentialRansac = *ransac;
+        sequentialRansac.parallel = false;
+    }
+
+    std::vector<PoseResult> results(jobs.size());
+    std::vector<PoseScratch> scratch(threadCount);
+    parallelForStealing(jobs.size(), threadCount, [&](size_t i, int thread) {
+        try {
+            results[i] = solvePose(jobs[i], intrinsics[intrinsics.size() == 1 ? 0 : i], ransac ? &sequentialRansac : nullptr,
+                &scratch[thread]);
+        }
+        catch (const cv::Exception& e) {
+            results[i].error = e.what();
+        }
+    });
+    return results;
+}
+
+int runBatch(const std::string& manifestPath) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Manifeste, intrinsques et maillage sont chargs une seule fois pour tous les jobs
+    BatchManifest manifest;
+    IntrinsicsStore intrinsicsStore;
+    PlyFile plyFile;
+    MeshCache meshCache;
+    try {
+        manifest = BatchManifest::load(manifestPath);
+        if (!manifest.intrinsics.empty()) {
+            intrinsicsStore = IntrinsicsStore::load(manifest.intrinsics);
+        }
+
+        bool needsMesh = std::any_of(manifest.jobs.begin(), manifest.jobs.end(),
+            [](const PoseJob& job) { return !job.vertexIndices.empty(); });
+        if (needsMesh) {
+            if (manifest.mesh.empty()) {
+                CV_Error(cv::Error::StsBadArg, "Des jobs utilisent des indices de sommets mais le manifeste n'a pas de \"mesh\"");
+            }
+            if (!meshCache.open(manifest.mesh)) {
+                plyFile = PlyFile::load(manifest.mesh);
+            }
+        }
+    }
+    catch (const cv::Exception& e) {
+        std::cerr << "Erreur lors du chargement du batch: " << e.what() << std::endl;
+        return -1;
+    }
+
+    VertexView meshVertices = meshCache.isOpen() ? meshCache.vertices() : plyFile.vertices();
+    const uint32_t* vertexRemap = meshCache.isOpen() ? meshCache.vertexRemap() : nullptr;
+    size_t sourceVertexCount = meshCache.isOpen() ? meshCache.sourceVertexCount() : plyFile.vertexCount();
+    bool hasIntrinsics = !manifest.intrinsics.empty();
+    std::cout << manifest.jobs.size() << " poses  estimer" << std::endl;
+
+    // Prparation des jobs sur tous les coeurs (indices, intrinsques,
+    // ventuel dcodage d'image), puis estimation par solvePoses
+    int threadCount = manifest.threads > 0 ? manifest.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<CameraIntrinsics> intrinsics(manifest.jobs.size());
+    std::vector<std::string> preparationErrors(manifest.jobs.size());
+    parallelForStealing(manifest.jobs.size(), threadCount, [&](size_t i, int) {
+        PoseJob& job = manifest.jobs[i];
+        try {
+            if (!job.vertexIndices.empty()) {
+                resolveVertexIndices(job, meshVertices, vertexRemap, sourceVertexCount);
+            }
+
+            // Sans taille dans le manifeste, on prend celle de la calibration,
+            // ou  dfaut celle de l'image (qu'il faut alors dcoder)
+            cv::Size imageSize = job.imageSize;
+            if (imageSize.area() == 0 && !hasIntrinsics) {
+                imageSize = cv::imread(job.image).size();
+                if (imageSize.area() == 0) {
+                    CV_Error(cv::Error::StsError, "Impossible de charger l'image " + job.image);
+                }
+            }
+            intrinsics[i] = !hasIntrinsics ? CameraIntrinsics::approximate(imageSize)
+                : (imageSize.area() == 0 ? intrinsicsStore.camera(job.camera) : intrinsicsStore.forImage(job.camera, imageSize));
+        }
+        catch (const cv::Exception& e) {
+            preparationErrors[i] = e.what();
+            job.objectPoints.clear();
+            job.imagePoints.clear();
+        }
+    });
+
+    std::vector<PoseResult> results = solvePoses(manifest.jobs, intrinsics,
+        manifest.ransac ? &manifest.ransacParams : nullptr, threadCount);
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!preparationErrors[i].empty()) {
+            results[i] = PoseResult();
+            results[i].error = preparationErrors[i];
+        }
+    }
+
+    size_t solved = 0;
+    double totalSolveTime = 0.0, maxSolveTime = 0.0;
+    for (const PoseResult& result : results) {
+        solved += result.success ? 1 : 0;
+        totalSolveTime += result.seconds;
+        maxSolveTime = std::max(maxSolveTime, result.seconds);
+    }
+
+    nlohmann::json poses = nlohmann::json::array();
+    for (size_t i = 0; i < results.size(); i++) {
+        nlohmann::json pose;
+        pose["image"] = manifest.jobs[i].image;
+        pose["success"] = results[i].success;
+        if (results[i].success) {
+            pose["rvec"] = matToJson(results[i].rvec);
+            pose["tvec"] = matToJson(results[i].tvec);
+            pose["rms"] = results[i].rmsError;
+            pose["ms"] = results[i].seconds * 1000.0;
+            if (!results[i].inlierMask.empty()) {
+                pose["inliers"] = results[i].inlierMask;
+            }
+        }
+        else {
+            pose["error"] = results[i].error;
+        }
+        poses.push_back(pose);
+    }
+
+    std::ofstream out(manifest.output);
+    out << nlohmann::json{ { "poses", poses } }.dump(2) << std::endl;
+    if (!out) {
+        std::cerr << "Impossible d'crire les poses dans " << manifest.output << std::endl;
+        return -1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << solved << " / " << results.size() << " poses estimes en " << seconds << " s, crites dans "
+        << manifest.output << std::endl;
+    if (!results.empty()) {
+        std::cout << "Dure par pose: " << totalSolveTime / results.size() * 1000.0 << " ms en moyenne, "
+            << maxSolveTime * 1000.0 << " ms au plus (" << threadCount << " threads)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Intrinsics.h"
+#include "PoseRefiner.h"
+#include "RansacPnP.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Une estimation de pose du mode batch: correspondances 2D-3D d'une image.
+// Les points 3D sont donns directement ou par indices de sommets du maillage.
+struct PoseJob {
+    std::string image;
+    std::string camera;                  // numro de srie ("" = camra par dfaut)
+    cv::Size imageSize;                  // vide si non prcise dans le manifeste
+    std::vector<cv::Point2f> imagePoints;
+    std::vector<cv::Point3f> objectPoints;
+    std::vector<int64_t> vertexIndices;  //  la place de objectPoints
+    std::vector<float> confidences;      // facultatif: confiance de chaque correspondance (PROSAC)
+};
+
+struct PoseResult {
+    bool success = false;
+    cv::Mat rvec;
+    cv::Mat tvec;
+    double rmsError = 0.0;    // erreur de reprojection en pixels
+    double seconds = 0.0;     // dure de l'estimation
+    std::vector<unsigned char> inlierMask;    // avec RANSAC: 1 par correspondance garde
+    std::string error;
+};
+
+// Tampons rutiliss d'un job  l'autre par un mme thread: matrice K,
+// raffinement et reprojection. L'estimation initiale par cv::solvePnP (EPnP)
+// alloue encore ses propres tampons  chaque job; une EPnP sans allocation
+// n'est pas fournie ici.
+struct PoseScratch {
+    cv::Mat cameraMatrix;
+    std::vector<cv::Point2f> projected;
+    PoseRefinerWorkspace<double> refiner;
+};
+
+// Manifeste JSON du mode batch:
+//   { "mesh": "modele.ply",             (facultatif, requis pour "vertices")
+//     "intrinsics": "intrinsics.json",  (facultatif)
+//     "output": "poses.json",
+//     "threads": 0,                     (facultatif, 0 = tous les coeurs)
+//     "ransac": { "threshold": 8, "confidence": 0.99, "iterations": 1000, "seed": 0 },  (facultatif)
+//     "jobs": [ { "image": "img.jpg", "camera": "<srie>", "width": ..., "height": ...,
+//                 "points2d": [[u, v], ...],
+//                 "points3d": [[x, y, z], ...] ou "vertices": [i, ...],
+//                 "confidences": [c, ...] (facultatif) }, ... ] }
+// Les chemins relatifs sont rsolus par rapport au dossier du manifeste.
+struct BatchManifest {
+    std::string mesh;
+    std::string intrinsics;
+    std::string output;
+    int threads = 0;
+    bool ransac = false;
+    RansacPnPParams ransacParams;
+    std::vector<PoseJob> jobs;
+
+    static BatchManifest load(const std::string& path);
+};
+
+// Remplace les indices de sommets d'un job par les points 3D du maillage.
+// Les indices sont ceux du PLY: si les sommets ont t souds, vertexRemap
+// (sourceVertexCount entres) donne leur indice dans vertices.
+void resolveVertexIndices(PoseJob& job, const VertexView& vertices, const uint32_t* vertexRemap = nullptr,
+    size_t sourceVertexCount = 0);
+
+// Pose d'un job (EPnP raffin par refinePose, ou RANSAC si ransac est fourni)
+// et erreur de reprojection (sur les correspondances gardes)
+PoseResult solvePose(const PoseJob& job, const CameraIntrinsics& intrinsics, const RansacPnPParams* ransac = nullptr,
+    PoseScratch* scratch = nullptr);
+
+// Poses de jobs indpendants sur tous les coeurs (vol de travail, tampons par
+// thread). intrinsics contient une entre par job, ou une seule pour tous.
+std::vector<PoseResult> solvePoses(const std::vector<PoseJob>& jobs, const std::vector<CameraIntrinsics>& intrinsics,
+    const RansacPnPParams* ransac = nullptr, int threadCount = 0);
+
+// Mode sans interface: rsout tous les jobs du manifeste avec le maillage
+// charg une seule fois et crit les poses dans le fichier de sortie.
+// Retourne le code de sortie du programme.
+int runBatch(const std::string& manifestPath);
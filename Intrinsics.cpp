@@ -0,0 +1,147 @@
+#include "Intrinsics.h"
+#include "json.hpp"
+
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+// cart relatif tolr entre le rapport largeur/hauteur de l'image et celui de la calibration
+const double aspectTolerance = 0.01;
+
+// Lit une camra; les champs absents reprennent ceux de base
+CameraIntrinsics parseCamera(const nlohmann::json& node, const CameraIntrinsics& base, const std::string& name) {
+    auto number = [&](const char* key, double fallback) {
+        if (!node.contains(key)) {
+            if (fallback <= 0.0) {
+                CV_Error(cv::Error::StsParseError, "Intrinsques " + name + ": champ \"" + key + "\" manquant");
+            }
+            return fallback;
+        }
+        return node.at(key).get<double>();
+    };
+
+    double fx = number("fx", base.fx);
+    double fy = number("fy", base.fy);
+    double cx = number("cx", base.cx);
+    double cy = number("cy", base.cy);
+    cv::Size size((int)number("width", base.imageSize.width), (int)number("height", base.imageSize.height));
+
+    cv::Mat distCoeffs = base.distCoeffs;
+    if (node.contains("dist")) {
+        std::vector<double> coefficients = node.at("dist").get<std::vector<double>>();
+        if (coefficients.size() != 4 && coefficients.size() != 5 && coefficients.size() != 8) {
+            CV_Error(cv::Error::StsParseError, "Intrinsques " + name + ": \"dist\" doit avoir 4, 5 ou 8 coefficients");
+        }
+        distCoeffs = cv::Mat(coefficients, true);
+    }
+    if (fx <= 0.0 || fy <= 0.0 || size.width <= 0 || size.height <= 0) {
+        CV_Error(cv::Error::StsBadArg, "Intrinsques " + name + ": focales et taille d'image doivent tre positives");
+    }
+    return CameraIntrinsics(fx, fy, cx, cy, size, distCoeffs);
+}
+
+} // namespace
+
+CameraIntrinsics::CameraIntrinsics(double fx, double fy, double cx, double cy, cv::Size imageSize, const cv::Mat& distCoeffs)
+    : fx(fx), fy(fy), cx(cx), cy(cy), imageSize(imageSize),
+    K(fx, 0, cx,
+        0, fy, cy,
+        0, 0, 1),
+    Kinv(1.0 / fx, 0, -cx / fx,
+        0, 1.0 / fy, -cy / fy,
+        0, 0, 1) {
+    if (distCoeffs.empty()) {
+        this->distCoeffs = cv::Mat::zeros(5, 1, CV_64F);
+    }
+    else {
+        distCoeffs.convertTo(this->distCoeffs, CV_64F);
+    }
+}
+
+CameraIntrinsics CameraIntrinsics::approximate(cv::Size imageSize) {
+    double focalLength = imageSize.width;
+    return CameraIntrinsics(focalLength, focalLength, imageSize.width / 2, imageSize.height / 2, imageSize);
+}
+
+CameraIntrinsics CameraIntrinsics::scaledTo(cv::Size size) const {
+    if (size == imageSize) {
+        return *this;
+    }
+    double scaleX = (double)size.width / imageSize.width;
+    double scaleY = (double)size.height / imageSize.height;
+    if (std::abs(scaleX / scaleY - 1.0) > aspectTolerance) {
+        CV_Error(cv::Error::StsBadSize, cv::format("Image %dx%d incompatible avec la calibration %dx%d",
+            size.width, size.height, imageSize.width, imageSize.height));
+    }
+    // La distorsion est exprime en coordonnes normalises: elle ne change pas
+    return CameraIntrinsics(fx * scaleX, fy * scaleY, cx * scaleX, cy * scaleY, size, distCoeffs);
+}
+
+IntrinsicsStore IntrinsicsStore::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        CV_Error(cv::Error::StsError, "Impossible d'ouvrir le fichier d'intrinsques " + path);
+    }
+
+    IntrinsicsStore store;
+    try {
+        nlohmann::json root = nlohmann::json::parse(in);
+        CameraIntrinsics defaults;
+        if (root.contains("fx")) {
+            defaults = parseCamera(root, CameraIntrinsics(), "par dfaut");
+            store.cameras_[""] = defaults;
+        }
+        if (root.contains("cameras")) {
+            for (const auto& camera : root.at("cameras").items()) {
+                store.cameras_[camera.key()] = parseCamera(camera.value(), defaults, camera.key());
+            }
+        }
+    }
+    catch (const nlohmann::json::exception& e) {
+        CV_Error(cv::Error::StsParseError, "Fichier d'intrinsques " + path + " invalide: " + e.what());
+    }
+
+    if (store.cameras_.empty()) {
+        CV_Error(cv::Error::StsParseError, "Aucune camra dans le fichier d'intrinsques " + path);
+    }
+    return store;
+}
+
+IntrinsicsStore::IntrinsicsStore(IntrinsicsStore&& other) noexcept
+    : cameras_(std::move(other.cameras_)), scaled_(std::move(other.scaled_)) {}
+
+IntrinsicsStore& IntrinsicsStore::operator=(IntrinsicsStore&& other) noexcept {
+    cameras_ = std::move(other.cameras_);
+    scaled_ = std::move(other.scaled_);
+    return *this;
+}
+
+std::vector<std::string> IntrinsicsStore::serials() const {
+    std::vector<std::string> result;
+    for (const auto& camera : cameras_) {
+        if (!camera.first.empty()) {
+            result.push_back(camera.first);
+        }
+    }
+    return result;
+}
+
+const CameraIntrinsics& IntrinsicsStore::camera(const std::string& serial) const {
+    auto camera = cameras_.find(serial);
+    if (camera == cameras_.end()) {
+        CV_Error(cv::Error::StsObjectNotFound, "Camra inconnue dans les intrinsques: " + serial);
+    }
+    return camera->second;
+}
+
+const CameraIntrinsics& IntrinsicsStore::forImage(const std::string& serial, cv::Size imageSize) const {
+    const CameraIntrinsics& calibrated = camera(serial);
+    std::lock_guard<std::mutex> lock(scaledMutex_);
+    auto key = std::make_tuple(serial, imageSize.width, imageSize.height);
+    auto cached = scaled_.find(key);
+    if (cached == scaled_.end()) {
+        cached = scaled_.emplace(key, calibrated.scaledTo(imageSize)).first;
+    }
+    return cached->second;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Paramtres intrinsques d'une camra (modle stnop + distorsion OpenCV).
+// La matrice K et son inverse sont calcules une fois  la construction.
+struct CameraIntrinsics {
+    double fx = 0.0;
+    double fy = 0.0;
+    double cx = 0.0;
+    double cy = 0.0;
+    cv::Size imageSize;
+    cv::Mat distCoeffs;    // 5x1 CV_64F (nuls si non prciss)
+    cv::Matx33d K;
+    cv::Matx33d Kinv;
+
+    CameraIntrinsics() = default;
+    CameraIntrinsics(double fx, double fy, double cx, double cy, cv::Size imageSize, const cv::Mat& distCoeffs = cv::Mat());
+
+    // Approximation utilise sans calibration: focale = largeur de l'image,
+    // point principal au centre
+    static CameraIntrinsics approximate(cv::Size imageSize);
+
+    cv::Mat cameraMatrix() const { return cv::Mat(K); }
+
+    // Intrinsques pour une image de la taille donne. Une image redimensionne
+    // (mme rapport largeur/hauteur) donne des paramtres mis  l'chelle; un
+    // autre rapport lve une erreur.
+    CameraIntrinsics scaledTo(cv::Size size) const;
+};
+
+// Intrinsques lues depuis un fichier JSON (intrinsics.json):
+//   { "fx": ..., "fy": ..., "cx": ..., "cy": ..., "width": ..., "height": ...,
+//     "dist": [k1, k2, p1, p2, k3],               (facultatif)
+//     "cameras": { "<numro de srie>": { ... } } (facultatif) }
+// Les valeurs de premier niveau dcrivent la camra par dfaut; une camra de
+// "cameras" reprend les valeurs par dfaut qu'elle ne redfinit pas.
+// Le fichier est lu une seule fois; les versions mises  l'chelle pour chaque
+// taille d'image sont gardes en cache (accs possible depuis plusieurs threads).
+class IntrinsicsStore {
+public:
+    static IntrinsicsStore load(const std::string& path);
+
+    IntrinsicsStore() = default;
+    IntrinsicsStore(IntrinsicsStore&& other) noexcept;
+    IntrinsicsStore& operator=(IntrinsicsStore&& other) noexcept;
+
+    bool hasDefault() const { return cameras_.count("") > 0; }
+    bool hasCamera(const std::string& serial) const { return cameras_.count(serial) > 0; }
+    // Numros de srie des camras du fichier (hors camra par dfaut)
+    std::vector<std::string> serials() const;
+
+    // Intrinsques calibres de la camra serial ("" pour la camra par dfaut)
+    const CameraIntrinsics& camera(const std::string& serial) const;
+
+    // Intrinsques de la camra serial, valides
+    // et mises  l'chelle pour imageSize
+    const CameraIntrinsics& forImage(const std::string& serial, cv::Size imageSize) const;
+
+private:
+    std::map<std::string, CameraIntrinsics> cameras_;
+    mutable std::mutex scaledMutex_;
+    mutable std::map<std::tuple<std::string, int, int>, CameraIntrinsics> scaled_;
+};
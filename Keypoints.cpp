@@ -0,0 +1,149 @@
+#include "Keypoints.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const float defaultRadiusRatio = 0.02f;
+
+// Valeurs propres d'une matrice symtrique 3x3 (mthode trigonomtrique),
+// par ordre dcroissant
+void symmetricEigenvalues(const double a[6], double eigenvalues[3]) {
+    // a: xx, yy, zz, xy, xz, yz
+    double offDiagonal = a[3] * a[3] + a[4] * a[4] + a[5] * a[5];
+    double q = (a[0] + a[1] + a[2]) / 3.0;
+    if (offDiagonal == 0.0) {
+        eigenvalues[0] = a[0];
+        eigenvalues[1] = a[1];
+        eigenvalues[2] = a[2];
+    }
+    else {
+        double b0 = a[0] - q, b1 = a[1] - q, b2 = a[2] - q;
+        double p = std::sqrt((b0 * b0 + b1 * b1 + b2 * b2 + 2.0 * offDiagonal) / 6.0);
+        double determinant = b0 * (b1 * b2 - a[5] * a[5]) - a[3] * (a[3] * b2 - a[5] * a[4]) +
+            a[4] * (a[3] * a[5] - b1 * a[4]);
+        double r = std::max(-1.0, std::min(1.0, determinant / (2.0 * p * p * p)));
+        double phi = std::acos(r) / 3.0;
+        eigenvalues[0] = q + 2.0 * p * std::cos(phi);
+        eigenvalues[2] = q + 2.0 * p * std::cos(phi + 2.0 * CV_PI / 3.0);
+        eigenvalues[1] = 3.0 * q - eigenvalues[0] - eigenvalues[2];
+    }
+    std::sort(eigenvalues, eigenvalues + 3, [](double x, double y) { return x > y; });
+}
+}
+
+std::vector<Keypoint> detectKeypoints(const VertexView& vertices, const SpatialGrid* grid, size_t count,
+    const KeypointParams& params) {
+    std::vector<Keypoint> keypoints;
+    if (vertices.size() == 0 || count == 0) {
+        return keypoints;
+    }
+
+    BoundingBox bounds = computeBoundingBox(vertices);
+    cv::Point3f extent = bounds.size();
+    float radius = params.supportRadius > 0.f ? params.supportRadius
+                                              : defaultRadiusRatio * std::sqrt(extent.dot(extent));
+    if (!(radius > 0.f)) {
+        return keypoints;
+    }
+    SpatialGrid ownGrid;
+    if (grid == nullptr || grid->empty()) {
+        ownGrid = SpatialGrid::build(vertices, bounds);
+        grid = &ownGrid;
+    }
+
+    // Rponse de chaque candidat (0: rejet)
+    std::vector<uint32_t> candidates = voxelSampleIndices(vertices, params.candidates);
+    std::vector<float> responses(candidates.size(), 0.f);
+    const float radius2 = radius * radius;
+#pragma omp parallel for schedule(dynamic, 64)
+    for (long long c = 0; c < (long long)candidates.size(); c++) {
+        cv::Point3f center = vertices[candidates[c]];
+
+        // Voisins pris  pas rgulier dans les cellules touches, pour borner
+        // le cot sur les modles denses
+        int x0, y0, z0, x1, y1, z1;
+        grid->cellCoords(center - cv::Point3f(radius, radius, radius), x0, y0, z0);
+        grid->cellCoords(center + cv::Point3f(radius, radius, radius), x1, y1, z1);
+        size_t total = 0;
+        for (int cz = z0; cz <= z1; cz++) {
+            for (int cy = y0; cy <= y1; cy++) {
+                for (int cx = x0; cx <= x1; cx++) {
+                    size_t cell = grid->cellIndex(cx, cy, cz);
+                    total += grid->cellStart()[cell + 1] - grid->cellStart()[cell];
+                }
+            }
+        }
+        size_t stride = std::max<size_t>(1, total / params.maxNeighbors);
+
+        // Moments centrs sur le candidat (moins d'annulations numriques)
+        double n = 0, sx = 0, sy = 0, sz = 0, sxx = 0, syy = 0, szz = 0, sxy = 0, sxz = 0, syz = 0;
+        size_t visited = 0;
+        for (int cz = z0; cz <= z1; cz++) {
+            for (int cy = y0; cy <= y1; cy++) {
+                for (int cx = x0; cx <= x1; cx++) {
+                    size_t cell = grid->cellIndex(cx, cy, cz);
+                    for (uint32_t k = grid->cellStart()[cell]; k < grid->cellStart()[cell + 1]; k++, visited++) {
+                        if (visited % stride != 0) {
+                            continue;
+                        }
+                        cv::Point3f d = vertices[grid->indices()[k]] - center;
+                        if (d.dot(d) > radius2) {
+                            continue;
+                        }
+                        n += 1;
+                        sx += d.x; sy += d.y; sz += d.z;
+                        sxx += (double)d.x * d.x; syy += (double)d.y * d.y; szz += (double)d.z * d.z;
+                        sxy += (double)d.x * d.y; sxz += (double)d.x * d.z; syz += (double)d.y * d.z;
+                    }
+                }
+            }
+        }
+        if (n < (double)params.minNeighbors) {
+            continue;
+        }
+
+        double mx = sx / n, my = sy / n, mz = sz / n;
+        double covariance[6] = { sxx / n - mx * mx, syy / n - my * my, szz / n - mz * mz,
+            sxy / n - mx * my, sxz / n - mx * mz, syz / n - my * mz };
+        double eigenvalues[3];
+        symmetricEigenvalues(covariance, eigenvalues);
+        double sum = eigenvalues[0] + eigenvalues[1] + eigenvalues[2];
+        if (!(eigenvalues[2] > 0.0) || !(sum > 0.0) || eigenvalues[1] > params.maxRatio21 * eigenvalues[0] ||
+            eigenvalues[2] > params.maxRatio32 * eigenvalues[1]) {
+            continue;
+        }
+        responses[c] = (float)(eigenvalues[2] / sum);
+    }
+
+    // Meilleures rponses, spares d'au moins un rayon
+    std::vector<uint32_t> ranking;
+    for (uint32_t c = 0; c < (uint32_t)candidates.size(); c++) {
+        if (responses[c] > 0.f) {
+            ranking.push_back(c);
+        }
+    }
+    std::sort(ranking.begin(), ranking.end(), [&](uint32_t a, uint32_t b) {
+        return responses[a] > responses[b] || (responses[a] == responses[b] && candidates[a] < candidates[b]);
+    });
+    std::vector<cv::Point3f> accepted;
+    for (uint32_t c : ranking) {
+        if (keypoints.size() >= count) {
+            break;
+        }
+        cv::Point3f p = vertices[candidates[c]];
+        bool isolated = true;
+        for (const cv::Point3f& q : accepted) {
+            cv::Point3f d = p - q;
+            if (d.dot(d) < radius2) {
+                isolated = false;
+                break;
+            }
+        }
+        if (isolated) {
+            accepted.push_back(p);
+            keypoints.push_back({ candidates[c], responses[c] });
+        }
+    }
+    return keypoints;
+}
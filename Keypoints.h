@@ -0,0 +1,32 @@
+#pragma once
+
+#include "SpatialGrid.h"
+#include "VertexView.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct KeypointParams {
+    size_t candidates = 20000;     // sommets valus, rpartis par voxels
+    float supportRadius = 0.f;     // rayon du voisinage; 0: 2 % de la diagonale du modle
+    size_t maxNeighbors = 256;     // voisins utiliss au plus (pris  pas rgulier)
+    size_t minNeighbors = 12;
+    float maxRatio21 = 0.975f;     // seuils ISS sur les rapports de valeurs propres
+    float maxRatio32 = 0.975f;
+};
+
+struct Keypoint {
+    uint32_t index;
+    float response;
+};
+
+// Points caractristiques gomtriques (rponse de type ISS): covariance du
+// voisinage de chaque candidat, dont la plus petite valeur propre relative
+// (variation de surface) est nulle sur un plan et grande sur un coin ou une
+// arte vive. Les candidats au repre propre ambigu (valeurs propres proches)
+// sont carts, puis les meilleurs sont retenus  au moins un rayon les uns
+// des autres. Rsultat tri par rponse dcroissante.
+// grid: grille des sommets si elle existe dj (cache), sinon construite ici.
+std::vector<Keypoint> detectKeypoints(const VertexView& vertices, const SpatialGrid* grid, size_t count,
+    const KeypointParams& params = KeypointParams());
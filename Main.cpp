@@ -2,7 +2,29 @@
 #include <opencv2/viz.hpp>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/viz/widgets.hpp>
+#include "Batch.h"
+#include "Intrinsics.h"
+#include "Keypoints.h"
+#include "MeshCache.h"
+#include "MeshRasterizer.h"
+#include "PlyReader.h"
+#include "PointOctree.h"
+#include "ProgressiveCloud.h"
+#include "Projection.h"
+#include "RansacPnP.h"
+#include "RenderMaps.h"
+#include "SelfCheck.h"
+#include "SpatialGrid.h"
+#include "TiledVertexStore.h"
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -12,6 +34,174 @@ std::vector<cv::Point3f> objectPoints;
 cv::Mat image;
 std::string windowName = "Slection des points sur l'image";
 
+// Nombre maximal de sommets proposs  la slection 3D
+const size_t maxSelectionSamples = 500;
+const size_t maxSelectionKeypoints = 200;    // points caractristiques proposs en premier
+const bool farthestPointSelection = true;
+// Slection par clic: distance (relative  la diagonale du modle) en de de
+// laquelle le point cliqu est ramen sur un point caractristique
+const float keypointSnapRatio = 0.01f;
+
+// Au-del de ce nombre de sommets, la fentre 3D s'ouvre tout de suite et les
+// sommets y sont ajouts progressivement pendant la prparation du maillage
+const size_t progressiveLoadingThreshold = 5000000;
+
+// Au-del de ce nombre de sommets, le modle est dcoup en tuiles sur disque
+// et seul un aperu chantillonn est gard en mmoire
+const size_t outOfCoreThreshold = 200000000;
+const size_t outOfCorePreviewSamples = 2000000;
+
+// Soudure des sommets confondus (exports avec sommets rpts par face),
+// tolrance relative  la diagonale du modle. 0: dsactive. Elle est faite
+// juste aprs la lecture du PLY, avant tout le reste (slection, BVH, rendu),
+// et le cache garde le rsultat pour les sessions suivantes. Les indices de
+// faces affichs ou exports restent ceux du PLY.
+// Ignore pour les modles dcoups en tuiles.
+const float weldRelativeTolerance = 1e-6f;
+
+// Avec le cache, l'affichage et la projection du maillage lisent les sommets
+// quantifis sur 16 bits (prcision: taille du modle / 131070). Les points
+// proposs  la slection restent exacts.
+const bool useCompactVertices = true;
+
+// Calibration de la camra (voir IntrinsicsStore pour le format)
+const std::string intrinsicsPath = "intrinsics.json";
+
+//  partir de ce nombre de correspondances, la pose est estime par RANSAC et
+// les correspondances incohrentes (clic erron) sont signales
+const size_t robustPoseMinPoints = 6;
+const double robustPoseThreshold = 8.0;    // pixels
+
+// Cartes de profondeur, de normales et de faces du rendu depuis la pose
+// estime (voir writeRenderMaps). La profondeur PNG est en millimes d'unit
+// du modle (millimtres pour un modle en mtres).
+const bool exportRenderMaps = true;
+const std::string renderMapsPrefix = "pose_render";
+const double depthPngScale = 1000.0;
+
+// Nuage  niveau de dtail (octree) de la fentre 3D: raffin autour de
+// l'endroit regard chaque fois que la camra s'immobilise. Au-del de
+// lodDisplayThreshold sommets, un nuage sans faces n'est affich que par lui.
+const size_t lodPointBudget = 500000;
+const float lodPointSpacing = 2.f;    // pixels
+const size_t lodDisplayThreshold = 2000000;
+
+// Sommets proposs  la slection: d'abord les points caractristiques
+// (coins, artes vives: faciles  retrouver sur la photo), du plus marqu au
+// moins marqu, puis les plus carts possible (meilleur conditionnement de
+// la pose) ou un par voxel occup.
+struct SelectionSamples {
+    std::vector<uint32_t> indices;
+    size_t keypointCount = 0;    // points caractristiques en tte de indices
+};
+
+SelectionSamples selectionSamples(const VertexView& vertices) {
+    SelectionSamples samples;
+    for (const Keypoint& keypoint : detectKeypoints(vertices, nullptr, maxSelectionKeypoints)) {
+        samples.indices.push_back(keypoint.index);
+    }
+    samples.keypointCount = samples.indices.size();
+    std::vector<uint32_t> spread = farthestPointSelection
+        ? farthestPointSampleIndices(vertices, maxSelectionSamples - samples.indices.size())
+        : voxelSampleIndices(vertices, maxSelectionSamples - samples.indices.size());
+    for (uint32_t index : spread) {
+        if (std::find(samples.indices.begin(), samples.indices.end(), index) == samples.indices.end()) {
+            samples.indices.push_back(index);
+        }
+    }
+    return samples;
+}
+
+// Positions des sommets proposs, points caractristiques en tte
+struct SelectionCandidates {
+    std::vector<cv::Point3f> points;
+    size_t keypointCount = 0;
+};
+
+// Camra courante de la fentre 3D (la pose Viz a l'axe z dans la direction de vise)
+LodCamera lodCamera(const cv::viz::Viz3d& window) {
+    cv::viz::Camera camera = window.getCamera();
+    cv::Affine3d pose = window.getViewerPose();
+    cv::Matx33d rotation = pose.rotation();
+    cv::Vec3d position = pose.translation();
+    cv::Vec2d focal = camera.getFocalLength();
+    cv::Vec2d principal = camera.getPrincipalPoint();
+    cv::Size size = camera.getWindowSize();
+
+    LodCamera result;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            result.r[i * 3 + j] = (float)rotation(j, i);
+        }
+    }
+    result.position = cv::Point3f((float)position[0], (float)position[1], (float)position[2]);
+    result.fx = (float)focal[0];
+    result.fy = (float)focal[1];
+    result.cx = (float)principal[0];
+    result.cy = (float)principal[1];
+    result.width = size.width;
+    result.height = size.height;
+    return result;
+}
+
+// vnements de la fentre 3D pendant la slection des points par clic,
+// traits par la boucle principale
+struct ClickSelection {
+    std::vector<cv::Point> picks;    // double-clics gauches  traiter
+    int removals = 0;                // double-clics droits: retirer le dernier point
+    bool finished = false;           // touche Entre
+};
+
+void onViz3dMouse(const cv::viz::MouseEvent& event, void* cookie) {
+    ClickSelection* clicks = static_cast<ClickSelection*>(cookie);
+    if (event.type != cv::viz::MouseEvent::MouseDblClick) {
+        return;
+    }
+    if (event.button == cv::viz::MouseEvent::LeftButton) {
+        clicks->picks.push_back(event.pointer);
+    }
+    else if (event.button == cv::viz::MouseEvent::RightButton) {
+        clicks->removals++;
+    }
+}
+
+void onViz3dKeyboard(const cv::viz::KeyboardEvent& event, void* cookie) {
+    if (event.action == cv::viz::KeyboardEvent::KEY_DOWN && (event.symbol == "Return" || event.symbol == "KP_Enter")) {
+        static_cast<ClickSelection*>(cookie)->finished = true;
+    }
+}
+
+// Clics sur l'image du rsultat: point du maillage vu au pixel cliqu, depuis
+// la pose estime, et distance au point du clic prcdent
+struct ResultMeasure {
+    const TriangleBvh* bvh = nullptr;
+    cv::Mat rvec, tvec, cameraMatrix, distCoeffs;
+    bool hasPrevious = false;
+    cv::Point3f previous;
+};
+
+void onResultClick(int event, int x, int y, int, void* userdata) {
+    if (event != cv::EVENT_LBUTTONDOWN) {
+        return;
+    }
+    ResultMeasure* measure = static_cast<ResultMeasure*>(userdata);
+    std::vector<RayHit> hits;
+    backProjectPoints(*measure->bvh, std::vector<cv::Point2f>(1, cv::Point2f((float)x, (float)y)), measure->rvec,
+        measure->tvec, measure->cameraMatrix, measure->distCoeffs, hits);
+    if (!hits[0].hit) {
+        std::cout << "Pixel (" << x << ", " << y << "): aucune surface du maillage." << std::endl;
+        return;
+    }
+    std::cout << "Pixel (" << x << ", " << y << "): point 3D " << hits[0].point << " (face " << hits[0].face << ")";
+    if (measure->hasPrevious) {
+        cv::Point3f d = hits[0].point - measure->previous;
+        std::cout << ", distance au point prcdent: " << std::sqrt(d.dot(d));
+    }
+    std::cout << std::endl;
+    measure->previous = hits[0].point;
+    measure->hasPrevious = true;
+}
+
 // Fonction callback pour les clics souris
 void onMouseClick(int event, int x, int y, int flags, void* userdata) {
     if (event == cv::EVENT_LBUTTONDOWN) {
@@ -29,42 +219,172 @@ void onMouseClick(int event, int x, int y, int flags, void* userdata) {
     }
 }
 
-int main() {
-    // 1. Demander le chemin du fichier PLY
+int main(int argc, char** argv) {
+    // Mode sans interface: SimplePnP --batch manifeste.json (voir Batch.h)
+    if (argc == 3 && std::string(argv[1]) == "--batch") {
+        return runBatch(argv[2]);
+    }
+    // Vrification des parties numriques sur donnes synthtiques (voir SelfCheck.h)
+    if (argc == 2 && std::string(argv[1]) == "--selfcheck") {
+        return runSelfCheck();
+    }
+
+    // 1. Demander les chemins du fichier PLY et de l'image
+    // Les deux chemins sont demands avant tout chargement: la lecture du
+    // maillage et le dcodage de l'image se font ensuite en parallle
     std::string plyFilePath;
     std::cout << "Entrez le chemin du fichier PLY: ";
     std::cin >> plyFilePath;
 
+    std::string imagePath;
+    std::cout << "Entrez le chemin de l'image: ";
+    std::cin >> imagePath;
+
+    std::future<cv::Mat> imageTask = std::async(std::launch::async, [imagePath]() {
+        return cv::imread(imagePath);
+    });
+
     // 2. Charger le maillage 3D depuis le fichier PLY
-    cv::viz::Mesh mesh;
+    // Le cache prtrait est utilis s'il est  jour. Sinon le PLY est projet
+    // en mmoire (seuls les sommets et les faces sont lus), soud, et le cache
+    // est crit en tche de fond pour les prochaines ouvertures.
+    // Les trs gros relevs sont dcoups une fois pour toutes en tuiles sur
+    // disque, lues ensuite  la demande.
+    PlyFile plyFile;
+    MeshCache meshCache;
+    TiledVertexStore tiledStore;
+    WeldedMesh weldedMesh;    // maillage du PLY soud (dclar avant cacheTask, qui le lit)
+    std::future<bool> cacheTask;
+    std::shared_future<SelectionSamples> selectionTask;    // calcul une fois pour le cache et l'affichage
     try {
-        mesh = cv::viz::Mesh::load(plyFilePath);
-        std::cout << "Maillage PLY charg avec succs." << std::endl;
-        std::cout << "Nombre de sommets: " << mesh.cloud.size() << std::endl;
+        if (tiledStore.open(plyFilePath)) {
+            std::cout << "Sommets chargs depuis les tuiles " << TiledVertexStore::tilesPath(plyFilePath) << std::endl;
+        }
+        else if (meshCache.open(plyFilePath) && meshCache.weldTolerance() == weldRelativeTolerance) {
+            std::cout << "Maillage charg depuis le cache " << MeshCache::cachePath(plyFilePath) << std::endl;
+        }
+        else {
+            meshCache.close();
+            plyFile = PlyFile::load(plyFilePath);
+            std::cout << "Maillage PLY charg avec succs." << std::endl;
+        }
+
+        if (plyFile.vertexCount() >= outOfCoreThreshold) {
+            std::cout << "Dcoupage des " << plyFile.vertexCount() << " sommets en tuiles..." << std::endl;
+            if (TiledVertexStore::build(plyFilePath, plyFile.vertices()) && tiledStore.open(plyFilePath)) {
+                plyFile = PlyFile();
+            }
+            else {
+                std::cout << "Impossible d'crire les tuiles, le modle reste entirement en mmoire." << std::endl;
+            }
+        }
+
+        if (plyFile.vertexCount() > 0) {
+            weldedMesh = weldMesh(plyFile.vertices(), plyFile.readPolygons(), weldRelativeTolerance);
+            const WeldReport& report = weldedMesh.report;
+            if (report.verticesBefore > 0) {
+                size_t removed = report.verticesBefore - report.verticesAfter;
+                std::cout << "Soudure des sommets: " << report.verticesBefore << " -> " << report.verticesAfter
+                    << " (" << 100.0 * removed / report.verticesBefore << " % en moins, "
+                    << removed * sizeof(cv::Point3f) / (1024.0 * 1024.0) << " Mo) en "
+                    << report.seconds * 1000.0 << " ms" << std::endl;
+            }
+
+            VertexView weldedVertices = weldedMesh.view(plyFile.vertices());
+            selectionTask = std::async(std::launch::async, [weldedVertices]() {
+                return selectionSamples(weldedVertices);
+            }).share();
+            cacheTask = std::async(std::launch::async, [&plyFile, &weldedMesh, plyFilePath, selectionTask]() {
+                try {
+                    const SelectionSamples& samples = selectionTask.get();
+                    return MeshCache::write(plyFilePath, plyFile, samples.indices, samples.keypointCount, &weldedMesh);
+                }
+                catch (const cv::Exception&) {
+                    return false;
+                }
+            });
+        }
     }
     catch (const cv::Exception& e) {
         std::cerr << "Erreur lors du chargement du fichier PLY: " << e.what() << std::endl;
         return -1;
     }
 
-    // Extraire les sommets du maillage
-    std::vector<cv::Point3f> meshVertices;
-    for (int i = 0; i < mesh.cloud.rows; i++) {
-        cv::Point3f vertex(
-            mesh.cloud.at<cv::Vec3f>(i)[0],
-            mesh.cloud.at<cv::Vec3f>(i)[1],
-            mesh.cloud.at<cv::Vec3f>(i)[2]
-        );
-        meshVertices.push_back(vertex);
-    }
+    // Vue sur les sommets du maillage (aucune copie, valide tant que le cache,
+    // plyFile ou weldedMesh existe), faces et face du PLY de chaque face.
+    // La vue est vide quand les sommets sont en tuiles: ils sont alors lus par tiledStore.
+    bool outOfCore = tiledStore.isOpen();
+    VertexView meshVertices = outOfCore ? VertexView()
+        : (meshCache.isOpen() ? meshCache.vertices() : weldedMesh.view(plyFile.vertices()));
+    const int* meshPolygons = meshCache.isOpen() ? meshCache.polygons() : weldedMesh.polygons.data();
+    size_t meshPolygonsSize = meshCache.isOpen() ? meshCache.polygonsSize() : weldedMesh.polygons.size();
+    const uint32_t* meshSourceFaces = meshCache.isOpen() ? meshCache.sourceFaces()
+        : (weldedMesh.sourceFaces.empty() ? nullptr : weldedMesh.sourceFaces.data());
+    std::cout << "Nombre de sommets: " << (outOfCore ? tiledStore.vertexCount() : meshVertices.size()) << std::endl;
+
+    // Les grands nuages sans faces sont affichs par l'octree  niveau de
+    // dtail, sans copie complte pour Viz
+    bool hasFaces = meshPolygonsSize > 0;
+    bool lodDisplay = !outOfCore && !hasFaces && meshVertices.size() > lodDisplayThreshold;
+
+    // 3. Prparer en parallle le maillage pour Viz et les sommets proposs  la slection
+    // (aperu chantillonn dans les tuiles pour les modles hors mmoire)
+    std::future<cv::viz::Mesh> vizMeshTask = std::async(std::launch::async,
+        [&meshCache, &weldedMesh, &tiledStore, meshVertices, lodDisplay]() {
+        if (lodDisplay) {
+            return cv::viz::Mesh();
+        }
+        if (tiledStore.isOpen()) {
+            cv::viz::Mesh preview;
+            preview.cloud = cv::Mat(tiledStore.sample(outOfCorePreviewSamples), true).reshape(3, 1);
+            return preview;
+        }
+        return meshCache.isOpen() ? meshCache.toVizMesh(useCompactVertices) : toVizMesh(meshVertices, weldedMesh.polygons);
+    });
 
-    // 3. Demander le chemin de l'image
-    std::string imagePath;
-    std::cout << "Entrez le chemin de l'image: ";
-    std::cin >> imagePath;
+    // Limiter le nombre de sommets  afficher pour la slection
+    // (chantillon prcalcul dans le cache quand il est disponible)
+    std::future<SelectionCandidates> samplingTask = std::async(std::launch::async,
+        [&meshCache, &tiledStore, meshVertices, selectionTask]() {
+        SelectionCandidates candidates;
+        if (tiledStore.isOpen()) {
+            candidates.points = tiledStore.sample(maxSelectionSamples);
+            return candidates;
+        }
+        SelectionSamples samples;
+        if (meshCache.isOpen()) {
+            samples.indices.assign(meshCache.sampleIndices(), meshCache.sampleIndices() + meshCache.sampleCount());
+            samples.keypointCount = meshCache.keypointCount();
+        }
+        else {
+            samples = selectionTask.get();
+        }
 
-    // 4. Charger l'image
-    image = cv::imread(imagePath);
+        candidates.points.reserve(samples.indices.size());
+        for (uint32_t index : samples.indices) {
+            candidates.points.push_back(meshVertices[index]);
+        }
+        candidates.keypointCount = samples.keypointCount;
+        return candidates;
+    });
+
+    // Octree pour l'affichage  niveau de dtail des grands nuages sans faces
+    std::future<PointOctree> octreeTask = std::async(std::launch::async, [lodDisplay, meshVertices]() {
+        return lodDisplay ? PointOctree::build(meshVertices) : PointOctree();
+    });
+
+    // Hirarchie de botes sur les faces, pour slectionner les points 3D par
+    // double-clic dans la fentre 3D (vide sans faces ou hors mmoire)
+    std::future<TriangleBvh> bvhTask = std::async(std::launch::async,
+        [outOfCore, meshVertices, meshPolygons, meshPolygonsSize, meshSourceFaces]() {
+        if (outOfCore || meshPolygonsSize == 0) {
+            return TriangleBvh();
+        }
+        return TriangleBvh::build(meshVertices, meshPolygons, meshPolygonsSize, meshSourceFaces);
+    });
+
+    // 4. Rcuprer l'image dcode
+    image = imageTask.get();
     if (image.empty()) {
         std::cerr << "Impossible de charger l'image!" << std::endl;
         return -1;
@@ -73,6 +393,37 @@ int main() {
     // Crer une copie de l'image originale pour la restauration aprs chaque slection
     cv::Mat originalImage = image.clone();
 
+    // Intrinsques de la camra, vrifies ds maintenant contre la taille de
+    // l'image (avant que l'utilisateur ne slectionne ses points)
+    CameraIntrinsics intrinsics = CameraIntrinsics::approximate(image.size());
+    if (std::filesystem::exists(intrinsicsPath)) {
+        try {
+            IntrinsicsStore intrinsicsStore = IntrinsicsStore::load(intrinsicsPath);
+            std::string serial;
+            if (!intrinsicsStore.hasDefault()) {
+                std::vector<std::string> serials = intrinsicsStore.serials();
+                serial = serials.front();
+                if (serials.size() > 1) {
+                    std::cout << "Numro de srie de la camra:";
+                    for (const std::string& s : serials) {
+                        std::cout << " " << s;
+                    }
+                    std::cout << std::endl << "> ";
+                    std::cin >> serial;
+                }
+            }
+            intrinsics = intrinsicsStore.forImage(serial, image.size());
+            std::cout << "Intrinsques charges depuis " << intrinsicsPath << std::endl;
+        }
+        catch (const cv::Exception& e) {
+            std::cerr << "Erreur dans les intrinsques de la camra: " << e.what() << std::endl;
+            return -1;
+        }
+    }
+    else {
+        std::cout << "Pas de fichier " << intrinsicsPath << ": focale approche par la largeur de l'image." << std::endl;
+    }
+
     // 5. Afficher le maillage 3D avec VIZ
     cv::viz::Viz3d window3D("Maillage 3D");
 
@@ -80,77 +431,270 @@ int main() {
     window3D.showWidget("Axes", cv::viz::WCoordinateSystem(1.0));
 
     // Cration d'un widget pour afficher le maillage complet
-    cv::viz::WMesh meshWidget(mesh);
-    window3D.showWidget("Maillage", meshWidget);
+    // (nuage de points seul si le fichier ne contient pas de faces)
+    auto showMeshWidget = [&window3D, &vizMeshTask, lodDisplay]() {
+        try {
+            cv::viz::Mesh mesh = vizMeshTask.get();
+            if (lodDisplay) {
+                // Trop de points pour VTK: le nuage  niveau de dtail les remplace
+                // (vizMeshTask n'a rien copi)
+            }
+            else if (mesh.polygons.empty()) {
+                window3D.showWidget("Maillage", cv::viz::WCloud(mesh.cloud, cv::viz::Color::white()));
+            }
+            else {
+                window3D.showWidget("Maillage", cv::viz::WMesh(mesh));
+            }
+        }
+        catch (const cv::Exception& e) {
+            std::cerr << "Erreur lors de la lecture des faces PLY: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // Chargement progressif: les sommets arrivent du plus grossier au plus fin
+    // et sont affichs au fur et  mesure; le maillage complet les remplace ds
+    // qu'il est prt. L'utilisateur peut naviguer et slectionner entre-temps.
+    // Retourne false si le maillage complet n'a pas pu tre affich.
+    std::unique_ptr<ProgressiveCloud> progressiveCloud;
+    int progressiveChunks = 0;
+    auto updateProgressiveDisplay = [&]() {
+        if (!progressiveCloud) {
+            return true;
+        }
+        std::vector<cv::Point3f> chunk;
+        if (progressiveCloud->popChunk(chunk)) {
+            window3D.showWidget("Progressif" + std::to_string(progressiveChunks++),
+                cv::viz::WCloud(chunk, cv::viz::Color::white()));
+        }
+        if (vizMeshTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            progressiveCloud.reset();
+            if (!showMeshWidget()) {
+                return false;
+            }
+            for (int i = 0; i < progressiveChunks; i++) {
+                window3D.removeWidget("Progressif" + std::to_string(i));
+            }
+        }
+        return true;
+    };
+
+    // Nuage  niveau de dtail: la coupe de l'octree n'est recalcule (et le
+    // widget remplac) que lorsque la camra est reste immobile une image,
+    // pour ne pas renvoyer les points  VTK pendant la rotation
+    PointOctree octree;
+    bool octreeReady = false;
+    LodCamera previousCamera, refinedCamera;
+    std::vector<uint32_t> lodCut;
+    std::vector<cv::Point3f> lodPoints;
+    auto updateLodDisplay = [&]() {
+        if (!octreeReady) {
+            if (octreeTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return;
+            }
+            octree = octreeTask.get();
+            octreeReady = true;
+        }
+        if (octree.empty()) {
+            return;
+        }
+        LodCamera camera = lodCamera(window3D);
+        bool moving = camera != previousCamera;
+        previousCamera = camera;
+        if (moving || (camera == refinedCamera && !lodCut.empty())) {
+            return;
+        }
+        refinedCamera = camera;
+
+        std::vector<uint32_t> cut;
+        octree.selectLod(camera, lodPointBudget, lodPointSpacing, cut);
+        if (cut == lodCut) {
+            return;
+        }
+        lodCut.swap(cut);
+        octree.gatherPoints(lodCut, lodPoints);
+        window3D.showWidget("NiveauDeDetail", cv::viz::WCloud(lodPoints, cv::viz::Color::white()));
+    };
+
+    // Chargement progressif des grands maillages, sauf pour le nuage  niveau de
+    // dtail (vizMeshTask ne prpare alors rien qu'il faudrait attendre)
+    if (meshVertices.size() >= progressiveLoadingThreshold && !lodDisplay) {
+        progressiveCloud = std::make_unique<ProgressiveCloud>(meshVertices,
+            meshCache.isOpen() ? &meshCache.grid() : nullptr);
+    }
+    else if (!showMeshWidget()) {
+        return -1;
+    }
 
     std::cout << "Visualisation 3D du maillage." << std::endl;
     std::cout << "Vous pouvez faire pivoter le modle avec la souris." << std::endl;
     std::cout << "Appuyez sur Q dans la fentre 3D pour continuer." << std::endl;
-    window3D.spin();
+    while (!window3D.wasStopped()) {
+        if (!updateProgressiveDisplay()) {
+            return -1;
+        }
+        updateLodDisplay();
+        window3D.spinOnce(10, true);
+    }
 
     // 6. Permettre  l'utilisateur de slectionner des points 3D spcifiques
     std::cout << "\nSlection des points 3D:" << std::endl;
     objectPoints.clear();
 
-    // Limiter le nombre de sommets  afficher pour la slection
-    int maxVerticesToDisplay = std::min(500, (int)meshVertices.size());
-    int stepSize = meshVertices.size() / maxVerticesToDisplay;
-    stepSize = stepSize < 1 ? 1 : stepSize;
-
-    std::vector<cv::Point3f> sampledVertices;
-    for (size_t i = 0; i < meshVertices.size(); i += stepSize) {
-        sampledVertices.push_back(meshVertices[i]);
+    TriangleBvh bvh;
+    try {
+        bvh = bvhTask.get();
+    }
+    catch (const cv::Exception& e) {
+        std::cerr << "Erreur lors de la lecture des faces PLY: " << e.what() << std::endl;
     }
 
-    std::cout << "Nombre de sommets chantillonns pour la slection: " << sampledVertices.size() << std::endl;
+    ClickSelection clicks;
+    if (!bvh.empty()) {
+        // Le rayon du pixel cliqu est lanc dans la hirarchie: le point
+        // retenu est exactement sur la surface, quelle que soit la taille du maillage
+        window3D.registerMouseCallback(onViz3dMouse, &clicks);
+        window3D.registerKeyboardCallback(onViz3dKeyboard, &clicks);
+
+        // Points caractristiques affichs en jaune: un clic assez proche est
+        // ramen sur le point, plus facile  retrouver exactement sur la photo
+        std::vector<cv::Point3f> keypoints;
+        try {
+            SelectionCandidates candidates = samplingTask.get();
+            keypoints.assign(candidates.points.begin(), candidates.points.begin() + candidates.keypointCount);
+        }
+        catch (const cv::Exception& e) {
+            std::cerr << "Points caractristiques indisponibles: " << e.what() << std::endl;
+        }
+        float snapRadius = 0.f;
+        if (!keypoints.empty()) {
+            cv::viz::WCloud keypointWidget(keypoints, cv::viz::Color::yellow());
+            keypointWidget.setRenderingProperty(cv::viz::POINT_SIZE, 6);
+            window3D.showWidget("PointsCaracteristiques", keypointWidget);
+            cv::Point3f extent = (meshCache.isOpen() ? meshCache.bounds() : computeBoundingBox(meshVertices)).size();
+            snapRadius = keypointSnapRatio * std::sqrt(extent.dot(extent));
+        }
 
-    bool selectionComplete = false;
-    int selectedIndex = 0;
+        std::cout << "Double-clic gauche sur le maillage: slectionner le point de la surface" << std::endl;
+        std::cout << "(ramen sur le point caractristique en jaune le plus proche, s'il est assez prs)." << std::endl;
+        std::cout << "Double-clic droit: retirer le dernier point. Entre: terminer la slection." << std::endl;
 
-    // Crer un widget nuage de points pour les sommets chantillonns
-    cv::viz::WCloud cloudWidget(sampledVertices, cv::viz::Color::white());
-    cloudWidget.setRenderingProperty(cv::viz::POINT_SIZE, 5);
-    window3D.showWidget("SampledPoints", cloudWidget);
+        bool selectionComplete = false;
+        while (!selectionComplete) {
+            if (!updateProgressiveDisplay()) {
+                return -1;
+            }
+            updateLodDisplay();
+            window3D.spinOnce(10, true);
+
+            for (const cv::Point& pointer : clicks.picks) {
+                cv::Point3d origin;
+                cv::Vec3d direction;
+                window3D.converTo3DRay(cv::Point3d(pointer.x, pointer.y, 0.0), origin, direction);
+                RayHit hit = bvh.intersect(cv::Point3f((float)origin.x, (float)origin.y, (float)origin.z),
+                    cv::Vec3f((float)direction[0], (float)direction[1], (float)direction[2]));
+                if (!hit.hit) {
+                    std::cout << "Aucune face sous le curseur." << std::endl;
+                    continue;
+                }
+                cv::Point3f point = hit.point;
+                float nearest = snapRadius * snapRadius;
+                bool snapped = false;
+                for (const cv::Point3f& keypoint : keypoints) {
+                    cv::Point3f d = keypoint - hit.point;
+                    if (d.dot(d) <= nearest) {
+                        nearest = d.dot(d);
+                        point = keypoint;
+                        snapped = true;
+                    }
+                }
+                objectPoints.push_back(point);
+                window3D.showWidget("PointMarker" + std::to_string(objectPoints.size()),
+                    cv::viz::WSphere(point, 0.02, 10, cv::viz::Color::red()));
+                std::cout << "Point 3D #" << objectPoints.size() << " slectionn: " << point
+                    << (snapped ? " (point caractristique)" : " (face " + std::to_string(hit.face) + ")") << std::endl;
+            }
+            clicks.picks.clear();
 
-    while (!selectionComplete) {
-        window3D.removeWidget("PointMarker");
+            for (; clicks.removals > 0 && !objectPoints.empty(); clicks.removals--) {
+                window3D.removeWidget("PointMarker" + std::to_string(objectPoints.size()));
+                objectPoints.pop_back();
+                std::cout << "Dernier point retir, " << objectPoints.size() << " slectionns." << std::endl;
+            }
+            clicks.removals = 0;
+
+            if (clicks.finished) {
+                clicks.finished = false;
+                if (objectPoints.size() >= 4) {
+                    selectionComplete = true;
+                }
+                else {
+                    std::cout << "Vous devez slectionner au moins 4 points pour l'estimation de pose!" << std::endl;
+                }
+            }
+        }
+    }
+    else {
+        // Sans faces: parcours des sommets chantillonns dans la console
+        std::vector<cv::Point3f> sampledVertices = samplingTask.get().points;
 
-        // Mettre en vidence le point actuel
-        cv::viz::WSphere currentPoint(sampledVertices[selectedIndex], 0.02, 10, cv::viz::Color::red());
-        window3D.showWidget("PointMarker", currentPoint);
-        window3D.spinOnce(1, true);
+        std::cout << "Nombre de sommets chantillonns pour la slection: " << sampledVertices.size() << std::endl;
 
-        std::cout << "Point 3D #" << (selectedIndex + 1) << " / " << sampledVertices.size() << ": "
-            << sampledVertices[selectedIndex] << std::endl;
-        std::cout << "Commandes: (s)lectionner ce point, (n)ext point, (p)revious point, (q)uitter la slection: ";
-        char response;
-        std::cin >> response;
+        bool selectionComplete = false;
+        int selectedIndex = 0;
 
-        switch (response) {
-        case 's': case 'S':
-            objectPoints.push_back(sampledVertices[selectedIndex]);
-            std::cout << "Point 3D #" << objectPoints.size() << " slectionn: "
-                << sampledVertices[selectedIndex] << std::endl;
-            break;
-        case 'n': case 'N':
-            selectedIndex = (selectedIndex + 1) % sampledVertices.size();
-            break;
-        case 'p': case 'P':
-            selectedIndex = (selectedIndex - 1 + sampledVertices.size()) % sampledVertices.size();
-            break;
-        case 'q': case 'Q':
-            if (objectPoints.size() >= 4) {
-                selectionComplete = true;
+        // Crer un widget nuage de points pour les sommets chantillonns
+        cv::viz::WCloud cloudWidget(sampledVertices, cv::viz::Color::white());
+        cloudWidget.setRenderingProperty(cv::viz::POINT_SIZE, 5);
+        window3D.showWidget("SampledPoints", cloudWidget);
+
+        while (!selectionComplete) {
+            window3D.removeWidget("PointMarker");
+
+            // Mettre en vidence le point actuel
+            cv::viz::WSphere currentPoint(sampledVertices[selectedIndex], 0.02, 10, cv::viz::Color::red());
+            window3D.showWidget("PointMarker", currentPoint);
+            if (!updateProgressiveDisplay()) {
+                return -1;
             }
-            else {
-                std::cout << "Vous devez slectionner au moins 4 points pour l'estimation de pose!" << std::endl;
+            updateLodDisplay();
+            window3D.spinOnce(1, true);
+
+            std::cout << "Point 3D #" << (selectedIndex + 1) << " / " << sampledVertices.size() << ": "
+                << sampledVertices[selectedIndex] << std::endl;
+            std::cout << "Commandes: (s)lectionner ce point, (n)ext point, (p)revious point, (q)uitter la slection: ";
+            char response;
+            std::cin >> response;
+
+            switch (response) {
+            case 's': case 'S':
+                objectPoints.push_back(sampledVertices[selectedIndex]);
+                std::cout << "Point 3D #" << objectPoints.size() << " slectionn: "
+                    << sampledVertices[selectedIndex] << std::endl;
+                break;
+            case 'n': case 'N':
+                selectedIndex = (selectedIndex + 1) % sampledVertices.size();
+                break;
+            case 'p': case 'P':
+                selectedIndex = (selectedIndex - 1 + sampledVertices.size()) % sampledVertices.size();
+                break;
+            case 'q': case 'Q':
+                if (objectPoints.size() >= 4) {
+                    selectionComplete = true;
+                }
+                else {
+                    std::cout << "Vous devez slectionner au moins 4 points pour l'estimation de pose!" << std::endl;
+                }
+                break;
+            default:
+                std::cout << "Commande non reconnue." << std::endl;
             }
-            break;
-        default:
-            std::cout << "Commande non reconnue." << std::endl;
         }
+
     }
 
+    progressiveCloud.reset();
     window3D.close();
 
     // 7. Permettre  l'utilisateur de slectionner les points correspondants sur l'image
@@ -173,22 +717,38 @@ int main() {
 
     cv::destroyWindow(windowName);
 
-    // 8. Calibration de la camra (pour un cas rel, ces paramtres devraient venir d'une calibration)
-    // Ici nous utilisons des valeurs approximatives bases sur la taille de l'image
-    double focalLength = image.cols;  // Une approximation raisonnable
-    cv::Point2d principalPoint(image.cols / 2, image.rows / 2);
-
-    cv::Mat cameraMatrix = (cv::Mat_<double>(3, 3) <<
-        focalLength, 0, principalPoint.x,
-        0, focalLength, principalPoint.y,
-        0, 0, 1);
-
-    cv::Mat distCoeffs = cv::Mat::zeros(5, 1, CV_64F);
+    // 8. Calibration de la camra (intrinsques lues  l'tape 4)
+    cv::Mat cameraMatrix = intrinsics.cameraMatrix();
+    cv::Mat distCoeffs = intrinsics.distCoeffs;
 
     // 9. Estimer la pose de la camra
     cv::Mat rvec, tvec;
-    bool success = cv::solvePnP(objectPoints, imagePoints, cameraMatrix,
-        distCoeffs, rvec, tvec);
+    std::vector<unsigned char> inlierMask(objectPoints.size(), 1);
+    bool success = false;
+    if (objectPoints.size() >= robustPoseMinPoints) {
+        RansacPnPParams ransacParams;
+        ransacParams.reprojectionThreshold = robustPoseThreshold;
+        RansacPnPResult ransac = solvePnPRansacParallel(objectPoints, imagePoints, cameraMatrix, distCoeffs, ransacParams);
+        success = ransac.success;
+        if (success) {
+            rvec = ransac.rvec;
+            tvec = ransac.tvec;
+            inlierMask = ransac.inlierMask;
+            std::cout << ransac.inlierCount << " correspondances cohrentes sur " << objectPoints.size()
+                << " (" << ransac.iterations << " itrations RANSAC, " << ransac.verifiedPoints << " points vrifis pour "
+                << ransac.hypotheses << " hypothses dont " << ransac.rejectedEarly << " abandonnes par SPRT)" << std::endl;
+            for (size_t i = 0; i < inlierMask.size(); i++) {
+                if (!inlierMask[i]) {
+                    std::cout << "Correspondance #" << (i + 1) << " carte: point 2D ou 3D probablement mal slectionn"
+                        << std::endl;
+                }
+            }
+        }
+    }
+    else {
+        success = cv::solvePnP(objectPoints, imagePoints, cameraMatrix,
+            distCoeffs, rvec, tvec);
+    }
 
     if (!success) {
         std::cerr << "chec de l'estimation de la pose!" << std::endl;
@@ -222,35 +782,81 @@ int main() {
     cv::line(image, projectedAxis[0], projectedAxis[2], cv::Scalar(0, 255, 0), 2);  // Y: vert
     cv::line(image, projectedAxis[0], projectedAxis[3], cv::Scalar(255, 0, 0), 2);  // Z: bleu
 
-    // Projeter une partie des sommets du maillage sur l'image
-    // Limiter le nombre de points  projeter pour viter de surcharger l'image
-    std::vector<cv::Point3f> projectVertices;
-    int projectionSample = std::max(1, (int)(meshVertices.size() / 500));
-    for (size_t i = 0; i < meshVertices.size(); i += projectionSample) {
-        projectVertices.push_back(meshVertices[i]);
+    // Superposer le maillage  l'image: faces visibles (tampon de profondeur),
+    //  dfaut tous les sommets projets, ou un chantillon des tuiles
+    // visibles hors mmoire
+    if (outOfCore) {
+        // Seules les tuiles devant la camra sont lues
+        std::vector<cv::Point2f> projectedMesh;
+        tiledStore.projectVisible(rvec, tvec, cameraMatrix, distCoeffs, 500, projectedMesh);
+        for (const auto& point : projectedMesh) {
+            if (point.x >= 0 && point.x < image.cols && point.y >= 0 && point.y < image.rows) {
+                cv::circle(image, point, 1, cv::Scalar(255, 255, 0), -1);
+            }
+        }
     }
+    else {
+        auto projectionStart = std::chrono::steady_clock::now();
+        ProjectionParams projection = ProjectionParams::make(rvec, tvec, cameraMatrix, distCoeffs, image.size());
+        if (meshPolygonsSize > 0) {
+            // Faces rendues avec tampon de profondeur: seules les surfaces
+            // visibles et leurs contours sont superposs
+            MeshRasterizer rasterizer(meshVertices, meshPolygons, meshPolygonsSize, meshSourceFaces);
+            RenderBuffers renderBuffers;
+            rasterizer.render(projection, renderBuffers);
+            rasterizer.drawOverlay(image, renderBuffers, projection, cv::Scalar(255, 255, 0), cv::Scalar(0, 255, 255), 0.5);
+            double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - projectionStart).count();
+            std::cout << "Rendu de " << rasterizer.triangleCount() << " triangles: " << renderMs << " ms" << std::endl;
+
+            if (exportRenderMaps) {
+                if (writeRenderMaps(renderMapsPrefix, rasterizer, renderBuffers, projection, depthPngScale)) {
+                    std::cout << "Cartes de profondeur, normales et faces sauvegardes dans " << renderMapsPrefix
+                        << "_*" << std::endl;
+                }
+                else {
+                    std::cerr << "Impossible d'crire les cartes du rendu " << renderMapsPrefix << "_*" << std::endl;
+                }
+            }
+        }
+        else {
+            cv::Mat vertexCounts;
+            if (meshCache.isOpen() && useCompactVertices) {
+                accumulateVertices(meshCache.compactVertices(), projection, vertexCounts);
+            }
+            else {
+                accumulateVertices(meshVertices, projection, vertexCounts);
+            }
+            double projectionMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - projectionStart).count();
+            std::cout << "Projection de " << meshVertices.size() << " sommets: " << projectionMs << " ms (noyau "
+                << projectionKernelName(projectionKernel()) << ")" << std::endl;
 
-    std::vector<cv::Point2f> projectedMesh;
-    cv::projectPoints(projectVertices, rvec, tvec, cameraMatrix, distCoeffs, projectedMesh);
-
-    // Dessiner les points projets du maillage
-    for (const auto& point : projectedMesh) {
-        if (point.x >= 0 && point.x < image.cols && point.y >= 0 && point.y < image.rows) {
-            cv::circle(image, point, 1, cv::Scalar(255, 255, 0), -1);
+            // Pixels couverts par le maillage, en surimpression semi-transparente
+            drawCoverage(image, vertexCounts, cv::Scalar(255, 255, 0), 0.6);
         }
     }
 
-    // Dessiner les points de correspondance
+    // Dessiner les points de correspondance (en rouge ceux carts par RANSAC)
     for (size_t i = 0; i < imagePoints.size(); i++) {
-        cv::circle(image, imagePoints[i], 5, cv::Scalar(0, 255, 0), -1);
+        cv::Scalar color = inlierMask[i] ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 0, 255);
+        cv::circle(image, imagePoints[i], 5, color, -1);
         cv::putText(image, std::to_string(i + 1),
             cv::Point(imagePoints[i].x + 10, imagePoints[i].y - 10),
-            cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
+            cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 2);
     }
 
     // 12. Afficher l'image finale avec la projection
     cv::namedWindow("Rsultat de l'estimation de pose", cv::WINDOW_NORMAL);
     cv::imshow("Rsultat de l'estimation de pose", image);
+    ResultMeasure measure;
+    if (!bvh.empty()) {
+        measure.bvh = &bvh;
+        measure.rvec = rvec;
+        measure.tvec = tvec;
+        measure.cameraMatrix = cameraMatrix;
+        measure.distCoeffs = distCoeffs;
+        cv::setMouseCallback("Rsultat de l'estimation de pose", onResultClick, &measure);
+        std::cout << "Cliquez sur l'image pour obtenir le point 3D correspondant du maillage." << std::endl;
+    }
     std::cout << "Appuyez sur une touche pour terminer..." << std::endl;
     cv::waitKey(0);
 
@@ -275,5 +881,15 @@ int main() {
         std::cerr << "Impossible d'ouvrir le fichier pour sauvegarder les paramtres de la camra." << std::endl;
     }
 
+    // Rsultat de l'criture du cache lance  l'tape 2
+    if (cacheTask.valid()) {
+        if (cacheTask.get()) {
+            std::cout << "Cache du maillage crit dans " << MeshCache::cachePath(plyFilePath) << std::endl;
+        }
+        else {
+            std::cout << "Impossible d'crire le cache du maillage, le PLY sera relu au prochain lancement." << std::endl;
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
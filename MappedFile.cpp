@@ -0,0 +1,150 @@
+#include "MappedFile.h"
+
+#include <opencv2/core.hpp>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+    map(path, 0, 0, true);
+}
+
+MappedFile::MappedFile(const std::string& path, uint64_t offset, size_t length) {
+    map(path, offset, length, false);
+}
+
+void MappedFile::map(const std::string& path, uint64_t offset, size_t length, bool wholeFile) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, wholeFile ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        CV_Error(cv::Error::StsObjectNotFound, "Impossible d'ouvrir le fichier: " + path);
+    }
+    fileHandle_ = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        CV_Error(cv::Error::StsError, "Fichier vide ou illisible: " + path);
+    }
+    uint64_t totalSize = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        CV_Error(cv::Error::StsObjectNotFound, "Impossible d'ouvrir le fichier: " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || st.st_size == 0) {
+        close();
+        CV_Error(cv::Error::StsError, "Fichier vide ou illisible: " + path);
+    }
+    uint64_t totalSize = static_cast<uint64_t>(st.st_size);
+#endif
+
+    if (wholeFile) {
+        length = static_cast<size_t>(totalSize);
+    }
+    if (length == 0 || offset > totalSize || length > totalSize - offset) {
+        close();
+        CV_Error(cv::Error::StsOutOfRange, "Plage hors du fichier: " + path);
+    }
+
+    // Le dbut d'une projection doit tre align sur la granularit du systme
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    uint64_t granularity = systemInfo.dwAllocationGranularity;
+#else
+    uint64_t granularity = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+#endif
+    uint64_t mapOffset = offset - offset % granularity;
+    size_t mapSize = static_cast<size_t>(offset - mapOffset) + length;
+
+#ifdef _WIN32
+    mappingHandle_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle_ == nullptr) {
+        close();
+        CV_Error(cv::Error::StsError, "Impossible de projeter le fichier en mmoire: " + path);
+    }
+
+    void* mapped = MapViewOfFile(mappingHandle_, FILE_MAP_READ,
+        static_cast<DWORD>(mapOffset >> 32), static_cast<DWORD>(mapOffset & 0xFFFFFFFFu), mapSize);
+    if (mapped == nullptr) {
+        close();
+        CV_Error(cv::Error::StsError, "Impossible de projeter le fichier en mmoire: " + path);
+    }
+#else
+    void* mapped = ::mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(mapOffset));
+    if (mapped == MAP_FAILED) {
+        close();
+        CV_Error(cv::Error::StsError, "Impossible de projeter le fichier en mmoire: " + path);
+    }
+#endif
+    mapBase_ = static_cast<const char*>(mapped);
+    mapSize_ = mapSize;
+    data_ = mapBase_ + (offset - mapOffset);
+    size_ = length;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mapBase_, other.mapBase_);
+        std::swap(mapSize_, other.mapSize_);
+#ifdef _WIN32
+        std::swap(fileHandle_, other.fileHandle_);
+        std::swap(mappingHandle_, other.mappingHandle_);
+#else
+        std::swap(fd_, other.fd_);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mapBase_ != nullptr) {
+        UnmapViewOfFile(mapBase_);
+    }
+    if (mappingHandle_ != nullptr) {
+        CloseHandle(mappingHandle_);
+    }
+    if (fileHandle_ != nullptr) {
+        CloseHandle(fileHandle_);
+    }
+    fileHandle_ = nullptr;
+    mappingHandle_ = nullptr;
+#else
+    if (mapBase_ != nullptr) {
+        ::munmap(const_cast<char*>(mapBase_), mapSize_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapBase_ = nullptr;
+    mapSize_ = 0;
+}
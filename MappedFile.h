@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Projection en mmoire (lecture seule) d'un fichier complet, ou d'une plage
+// [offset, offset + length) du fichier.
+// Les pages sont charges  la demande par le systme : rien n'est copi
+// tant que les donnes ne sont pas effectivement lues.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    MappedFile(const std::string& path, uint64_t offset, size_t length);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return data_ != nullptr; }
+
+    void close();
+
+private:
+    void map(const std::string& path, uint64_t offset, size_t length, bool wholeFile);
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    // La projection commence  un multiple de la granularit du systme,
+    // ventuellement avant data_
+    const char* mapBase_ = nullptr;
+    size_t mapSize_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
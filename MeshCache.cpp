@@ -0,0 +1,485 @@
+#include "MeshCache.h"
+#include "PlyReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <system_error>
+#include <type_traits>
+
+namespace {
+
+const char cacheMagic[8] = { 'S', 'P', 'N', 'P', 'M', 'S', 'H', '\0' };
+const uint32_t cacheVersion = 6;    // 6: maillage soud, correspondance avec les sommets et faces du PLY
+const size_t sectionAlignment = 64;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hasGrid;
+    uint64_t fileSize;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint64_t vertexCount;
+    uint64_t polygonsSize;
+    uint64_t sampleCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float quantizationStep[3];
+    float gridOrigin[3];
+    float gridCellSize;
+    int32_t gridDims[3];
+    float weldTolerance;
+    uint64_t xOffset;
+    uint64_t yOffset;
+    uint64_t zOffset;
+    uint64_t qxOffset;
+    uint64_t qyOffset;
+    uint64_t qzOffset;
+    uint64_t polygonsOffset;
+    uint64_t samplesOffset;
+    uint64_t cellStartOffset;
+    uint64_t indicesOffset;
+    uint64_t keypointCount;
+    uint64_t sourceVertexCount;
+    uint64_t remapOffset;
+    uint64_t faceCount;             // faces du cache
+    uint64_t sourceFaceCount;       // faces du PLY
+    uint64_t sourceFacesOffset;     // 0 si aucune face n'a t supprime par la soudure
+};
+static_assert(std::is_trivially_copyable<CacheHeader>::value, "CacheHeader doit rester un POD");
+
+// Empreinte FNV-1a du dbut, de la fin et de 16 blocs rpartis dans le fichier
+uint64_t sourceFingerprint(const char* data, size_t size) {
+    const size_t edgeBlock = 1 << 20;
+    const size_t innerBlock = 1 << 16;
+    const int innerBlocks = 16;
+
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&](size_t begin, size_t length) {
+        length = std::min(length, size - begin);
+        for (size_t i = begin; i < begin + length; i++) {
+            hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+        }
+    };
+
+    mix(0, edgeBlock);
+    if (size > edgeBlock) {
+        mix(size - std::min(size, edgeBlock), edgeBlock);
+    }
+    for (int b = 1; b <= innerBlocks; b++) {
+        mix(size / (innerBlocks + 1) * b, innerBlock);
+    }
+    return hash ^ size;
+}
+
+class SectionWriter {
+public:
+    explicit SectionWriter(std::ofstream& out) : out_(out) {}
+
+    uint64_t append(const void* data, size_t bytes) {
+        pad();
+        uint64_t offset = position_;
+        out_.write(static_cast<const char*>(data), bytes);
+        position_ += bytes;
+        return offset;
+    }
+
+    // Une composante (0: x, 1: y, 2: z) des sommets, par blocs
+    uint64_t appendComponent(const VertexView& vertices, int axis) {
+        pad();
+        uint64_t offset = position_;
+        const size_t blockSize = 1 << 16;
+        std::vector<float> block;
+        for (size_t first = 0; first < vertices.size(); first += blockSize) {
+            VertexView part = vertices.subview(first, blockSize);
+            block.resize(part.size());
+            for (size_t i = 0; i < part.size(); i++) {
+                cv::Point3f p = part[i];
+                block[i] = axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+            }
+            out_.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(float));
+            position_ += block.size() * sizeof(float);
+        }
+        return offset;
+    }
+
+    // Une composante quantifie sur 16 bits (voir QuantizedVertexView)
+    uint64_t appendQuantizedComponent(const VertexView& vertices, int axis, float origin, float step) {
+        pad();
+        uint64_t offset = position_;
+        const size_t blockSize = 1 << 16;
+        std::vector<uint16_t> block;
+        for (size_t first = 0; first < vertices.size(); first += blockSize) {
+            VertexView part = vertices.subview(first, blockSize);
+            block.resize(part.size());
+            for (size_t i = 0; i < part.size(); i++) {
+                cv::Point3f p = part[i];
+                block[i] = QuantizedVertexView::quantize(axis == 0 ? p.x : (axis == 1 ? p.y : p.z), origin, step);
+            }
+            out_.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(uint16_t));
+            position_ += block.size() * sizeof(uint16_t);
+        }
+        return offset;
+    }
+
+    uint64_t position() const { return position_; }
+
+private:
+    void pad() {
+        static const char zeros[sectionAlignment] = {};
+        size_t padding = (sectionAlignment - position_ % sectionAlignment) % sectionAlignment;
+        out_.write(zeros, padding);
+        position_ += padding;
+    }
+
+    std::ofstream& out_;
+    uint64_t position_ = sizeof(CacheHeader);
+};
+
+bool sectionFits(uint64_t offset, uint64_t bytes, uint64_t fileSize) {
+    return offset % sectionAlignment == 0 && offset <= fileSize && bytes <= fileSize - offset;
+}
+
+// Tous les indices de values dsignent un des limit sommets
+bool indicesBelow(const uint32_t* values, size_t count, uint64_t limit) {
+    int invalid = 0;
+#pragma omp parallel for reduction(|:invalid)
+    for (long long i = 0; i < (long long)count; i++) {
+        invalid |= values[i] >= limit ? 1 : 0;
+    }
+    return invalid == 0;
+}
+
+// Faces au format cv::viz::Mesh::polygons bien formes et dont les indices
+// dsignent des sommets existants. Le dcoupage en faces est squentiel (seules
+// les tailles sont lues); les indices sont vrifis en parallle, par paquets
+// de faces.
+bool polygonsValid(const int* polygons, size_t polygonsSize, uint64_t vertexCount, size_t& faceCount) {
+    const size_t facesPerBlock = 1 << 14;
+    std::vector<size_t> blockStart;
+    faceCount = 0;
+    for (size_t i = 0; i < polygonsSize; i += 1 + (size_t)polygons[i], faceCount++) {
+        if (polygons[i] < 0 || (size_t)polygons[i] >= polygonsSize - i) {
+            return false;
+        }
+        if (faceCount % facesPerBlock == 0) {
+            blockStart.push_back(i);
+        }
+    }
+    blockStart.push_back(polygonsSize);
+
+    int invalid = 0;
+#pragma omp parallel for reduction(|:invalid)
+    for (long long b = 0; b < (long long)blockStart.size() - 1; b++) {
+        for (size_t i = blockStart[b]; i < blockStart[b + 1]; i += 1 + (size_t)polygons[i]) {
+            for (int k = 1; k <= polygons[i]; k++) {
+                invalid |= polygons[i + k] < 0 || (uint64_t)polygons[i + k] >= vertexCount ? 1 : 0;
+            }
+        }
+    }
+    return invalid == 0;
+}
+
+} // namespace
+
+bool readSourceIdentity(const std::string& path, SourceIdentity& identity) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    try {
+        MappedFile source(path);
+        identity.size = source.size();
+        identity.time = (int64_t)time.time_since_epoch().count();
+        identity.hash = sourceFingerprint(source.data(), source.size());
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+    return true;
+}
+
+std::string MeshCache::cachePath(const std::string& plyPath) {
+    return plyPath + ".spnpcache";
+}
+
+bool MeshCache::write(const std::string& plyPath, const PlyFile& ply, const std::vector<uint32_t>& sampleIndices,
+    size_t keypointCount, const WeldedMesh* welded) {
+    CV_Assert(keypointCount <= sampleIndices.size());
+    SourceIdentity identity;
+    if (!readSourceIdentity(plyPath, identity)) {
+        return false;
+    }
+
+    // Sommets et faces souds s'ils sont fournis, sinon ceux du PLY
+    VertexView vertices = welded ? welded->view(ply.vertices()) : ply.vertices();
+    std::vector<int> plyPolygons;
+    if (!welded) {
+        plyPolygons = ply.readPolygons();
+    }
+    const std::vector<int>& polygons = welded ? welded->polygons : plyPolygons;
+    const std::vector<uint32_t> noRemap;
+    const std::vector<uint32_t>& remap = welded ? welded->vertexRemap : noRemap;
+    const std::vector<uint32_t>& sourceFaces = welded ? welded->sourceFaces : noRemap;
+    size_t faceCount = 0;
+    if (!polygonsValid(polygons.data(), polygons.size(), vertices.size(), faceCount)) {
+        return false;
+    }
+    CV_Assert(sourceFaces.empty() || sourceFaces.size() == faceCount);
+    size_t sourceFaceCount = sourceFaces.empty() ? faceCount : ply.faceCount();
+
+    BoundingBox bounds = computeBoundingBox(vertices);
+    bool hasGrid = vertices.size() < std::numeric_limits<uint32_t>::max();
+    SpatialGrid grid;
+    if (hasGrid) {
+        grid = SpatialGrid::build(vertices, bounds);
+    }
+
+    std::string path = cachePath(plyPath);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        CacheHeader header = {};
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = cacheVersion;
+        header.hasGrid = hasGrid ? 1 : 0;
+        header.sourceSize = identity.size;
+        header.sourceTime = identity.time;
+        header.sourceHash = identity.hash;
+        header.vertexCount = vertices.size();
+        header.polygonsSize = polygons.size();
+        header.faceCount = faceCount;
+        header.sourceFaceCount = sourceFaceCount;
+        header.sampleCount = sampleIndices.size();
+        header.keypointCount = keypointCount;
+        header.boundsMin[0] = bounds.min.x; header.boundsMin[1] = bounds.min.y; header.boundsMin[2] = bounds.min.z;
+        header.boundsMax[0] = bounds.max.x; header.boundsMax[1] = bounds.max.y; header.boundsMax[2] = bounds.max.z;
+        header.weldTolerance = welded ? welded->tolerance : 0.f;
+        header.sourceVertexCount = ply.vertexCount();
+
+        // L'en-tte est rcrit  la fin, une fois les positions connues
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        SectionWriter sections(out);
+        header.xOffset = sections.appendComponent(vertices, 0);
+        header.yOffset = sections.appendComponent(vertices, 1);
+        header.zOffset = sections.appendComponent(vertices, 2);
+        cv::Point3f step = QuantizedVertexView::quantizationStep(bounds);
+        header.quantizationStep[0] = step.x; header.quantizationStep[1] = step.y; header.quantizationStep[2] = step.z;
+        header.qxOffset = sections.appendQuantizedComponent(vertices, 0, bounds.min.x, step.x);
+        header.qyOffset = sections.appendQuantizedComponent(vertices, 1, bounds.min.y, step.y);
+        header.qzOffset = sections.appendQuantizedComponent(vertices, 2, bounds.min.z, step.z);
+        header.polygonsOffset = sections.append(polygons.data(), polygons.size() * sizeof(int));
+        header.samplesOffset = sections.append(sampleIndices.data(), sampleIndices.size() * sizeof(uint32_t));
+        if (hasGrid) {
+            header.gridOrigin[0] = grid.origin().x; header.gridOrigin[1] = grid.origin().y; header.gridOrigin[2] = grid.origin().z;
+            header.gridCellSize = grid.cellSize();
+            for (int axis = 0; axis < 3; axis++) {
+                header.gridDims[axis] = grid.dim(axis);
+            }
+            header.cellStartOffset = sections.append(grid.cellStart(), (grid.cellCount() + 1) * sizeof(uint32_t));
+            header.indicesOffset = sections.append(grid.indices(), grid.indexCount() * sizeof(uint32_t));
+        }
+        if (!remap.empty()) {
+            header.remapOffset = sections.append(remap.data(), remap.size() * sizeof(uint32_t));
+        }
+        if (!sourceFaces.empty()) {
+            header.sourceFacesOffset = sections.append(sourceFaces.data(), sourceFaces.size() * sizeof(uint32_t));
+        }
+        header.fileSize = sections.position();
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temporaryPath);
+            return false;
+        }
+    }
+
+    // Remplacement atomique d'un ventuel ancien cache
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::open(const std::string& plyPath) {
+    close();
+
+    std::string path = cachePath(plyPath);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        return false;
+    }
+
+    SourceIdentity identity;
+    if (!readSourceIdentity(plyPath, identity)) {
+        return false;
+    }
+
+    MappedFile file;
+    try {
+        file = MappedFile(path);
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+
+    CacheHeader header;
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+        header.fileSize != file.size()) {
+        return false;
+    }
+    if (header.sourceSize != identity.size || header.sourceTime != identity.time || header.sourceHash != identity.hash) {
+        return false;
+    }
+
+    uint64_t componentBytes = header.vertexCount * sizeof(float);
+    uint64_t quantizedBytes = header.vertexCount * sizeof(uint16_t);
+    if (!sectionFits(header.xOffset, componentBytes, file.size()) ||
+        !sectionFits(header.yOffset, componentBytes, file.size()) ||
+        !sectionFits(header.zOffset, componentBytes, file.size()) ||
+        !sectionFits(header.qxOffset, quantizedBytes, file.size()) ||
+        !sectionFits(header.qyOffset, quantizedBytes, file.size()) ||
+        !sectionFits(header.qzOffset, quantizedBytes, file.size()) ||
+        !sectionFits(header.polygonsOffset, header.polygonsSize * sizeof(int), file.size()) ||
+        !sectionFits(header.samplesOffset, header.sampleCount * sizeof(uint32_t), file.size()) ||
+        header.keypointCount > header.sampleCount) {
+        return false;
+    }
+    if (header.remapOffset != 0 &&
+        !sectionFits(header.remapOffset, header.sourceVertexCount * sizeof(uint32_t), file.size())) {
+        return false;
+    }
+    if (header.sourceFacesOffset != 0 &&
+        !sectionFits(header.sourceFacesOffset, header.faceCount * sizeof(uint32_t), file.size())) {
+        return false;
+    }
+
+    // Indices relus du fichier: un cache abm ne doit pas faire lire hors des
+    // sommets (affichage, BVH, slection)
+    const char* base = file.data();
+    size_t faceCount = 0;
+    if (!polygonsValid(reinterpret_cast<const int*>(base + header.polygonsOffset), header.polygonsSize,
+            header.vertexCount, faceCount) ||
+        faceCount != header.faceCount ||
+        !indicesBelow(reinterpret_cast<const uint32_t*>(base + header.samplesOffset), header.sampleCount,
+            header.vertexCount)) {
+        return false;
+    }
+    if (header.remapOffset != 0 &&
+        !indicesBelow(reinterpret_cast<const uint32_t*>(base + header.remapOffset), header.sourceVertexCount,
+            header.vertexCount)) {
+        return false;
+    }
+    if (header.sourceFacesOffset != 0 &&
+        !indicesBelow(reinterpret_cast<const uint32_t*>(base + header.sourceFacesOffset), header.faceCount,
+            header.sourceFaceCount)) {
+        return false;
+    }
+
+    if (header.hasGrid) {
+        if (header.gridDims[0] <= 0 || header.gridDims[1] <= 0 || header.gridDims[2] <= 0) {
+            return false;
+        }
+        size_t cellCount = (size_t)header.gridDims[0] * header.gridDims[1] * header.gridDims[2];
+        if (!sectionFits(header.cellStartOffset, (cellCount + 1) * sizeof(uint32_t), file.size()) ||
+            !sectionFits(header.indicesOffset, header.vertexCount * sizeof(uint32_t), file.size())) {
+            return false;
+        }
+        const uint32_t* cellStart = reinterpret_cast<const uint32_t*>(base + header.cellStartOffset);
+        if (cellStart[cellCount] != header.vertexCount ||
+            !indicesBelow(cellStart, cellCount, (uint64_t)header.vertexCount + 1) ||
+            !indicesBelow(reinterpret_cast<const uint32_t*>(base + header.indicesOffset), header.vertexCount,
+                header.vertexCount)) {
+            return false;
+        }
+        grid_ = SpatialGrid::fromArrays(
+            cv::Point3f(header.gridOrigin[0], header.gridOrigin[1], header.gridOrigin[2]), header.gridCellSize,
+            header.gridDims, reinterpret_cast<const uint32_t*>(base + header.cellStartOffset),
+            reinterpret_cast<const uint32_t*>(base + header.indicesOffset));
+    }
+
+    x_ = reinterpret_cast<const float*>(base + header.xOffset);
+    y_ = reinterpret_cast<const float*>(base + header.yOffset);
+    z_ = reinterpret_cast<const float*>(base + header.zOffset);
+    qx_ = reinterpret_cast<const uint16_t*>(base + header.qxOffset);
+    qy_ = reinterpret_cast<const uint16_t*>(base + header.qyOffset);
+    qz_ = reinterpret_cast<const uint16_t*>(base + header.qzOffset);
+    quantizationStep_ = cv::Point3f(header.quantizationStep[0], header.quantizationStep[1], header.quantizationStep[2]);
+    vertexCount_ = header.vertexCount;
+    polygons_ = reinterpret_cast<const int*>(base + header.polygonsOffset);
+    polygonsSize_ = header.polygonsSize;
+    sourceFaces_ = header.sourceFacesOffset != 0
+        ? reinterpret_cast<const uint32_t*>(base + header.sourceFacesOffset) : nullptr;
+    sampleIndices_ = reinterpret_cast<const uint32_t*>(base + header.samplesOffset);
+    sampleCount_ = header.sampleCount;
+    keypointCount_ = header.keypointCount;
+    vertexRemap_ = header.remapOffset != 0 ? reinterpret_cast<const uint32_t*>(base + header.remapOffset) : nullptr;
+    sourceVertexCount_ = header.sourceVertexCount;
+    weldTolerance_ = header.weldTolerance;
+    bounds_.min = cv::Point3f(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    bounds_.max = cv::Point3f(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    file_ = std::move(file);
+    return true;
+}
+
+void MeshCache::close() {
+    file_.close();
+    x_ = y_ = z_ = nullptr;
+    qx_ = qy_ = qz_ = nullptr;
+    vertexCount_ = 0;
+    polygons_ = nullptr;
+    polygonsSize_ = 0;
+    sourceFaces_ = nullptr;
+    sampleIndices_ = nullptr;
+    sampleCount_ = 0;
+    keypointCount_ = 0;
+    vertexRemap_ = nullptr;
+    sourceVertexCount_ = 0;
+    weldTolerance_ = 0.f;
+    grid_ = SpatialGrid();
+}
+
+VertexView MeshCache::vertices() const {
+    return VertexView::fromComponents(x_, y_, z_, vertexCount_);
+}
+
+QuantizedVertexView MeshCache::compactVertices() const {
+    return QuantizedVertexView(qx_, qy_, qz_, vertexCount_, bounds_.min, quantizationStep_);
+}
+
+cv::viz::Mesh MeshCache::toVizMesh(bool compact) const {
+    cv::viz::Mesh mesh;
+    if (compact) {
+        mesh.cloud = compactVertices().toCloud();
+    }
+    else {
+        mesh.cloud.create(1, (int)vertexCount_, CV_32FC3);
+        cv::Point3f* cloud = mesh.cloud.ptr<cv::Point3f>();
+        for (size_t i = 0; i < vertexCount_; i++) {
+            cloud[i] = cv::Point3f(x_[i], y_[i], z_[i]);
+        }
+    }
+    if (polygonsSize_ > 0) {
+        // Le widget ne fait que lire les faces: pas de copie
+        mesh.polygons = cv::Mat(1, (int)polygonsSize_, CV_32SC1, const_cast<int*>(polygons_));
+    }
+    return mesh;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshWelding.h"
+#include "QuantizedVertexView.h"
+#include "SpatialGrid.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/viz.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class PlyFile;
+
+// Identit d'un fichier source: taille, date de modification et empreinte du
+// contenu (calcule sur des blocs rpartis dans le fichier, pour que la
+// vrification reste instantane sur des fichiers de plusieurs Go).
+// Sert  savoir si un fichier driv (cache, tuiles) est encore  jour.
+struct SourceIdentity {
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+};
+
+bool readSourceIdentity(const std::string& path, SourceIdentity& identity);
+
+// Cache de maillage prtrait, crit  ct du PLY ("<fichier>.spnpcache").
+// Il contient les sommets en trois tableaux x[], y[], z[] (en float et quantifis
+// sur 16 bits dans la bote englobante), les faces au format
+// cv::viz::Mesh, la bote englobante, l'chantillon de slection et une grille
+// spatiale. Le fichier est projet en mmoire: l'ouverture lit l'en-tte et
+// vrifie les indices (faces, slection, grille), sans copier les sommets.
+// Avec une soudure, le cache contient les sommets et faces souds (voir
+// weldMesh) et, s'il y avait des doublons, la correspondance des indices de
+// sommets du PLY vers ces sommets et la face du PLY de chaque face garde.
+// Le cache est associ au PLY source par son SourceIdentity.
+class MeshCache {
+public:
+    static std::string cachePath(const std::string& plyPath);
+
+    // crit le cache pour plyPath. Retourne false si le fichier ne peut pas
+    // tre crit (dossier en lecture seule...).
+    // welded: soudure de ply dj faite par weldMesh, crite  la place de ses
+    // sommets et faces. sampleIndices dsigne des sommets du maillage crit
+    // (soud le cas chant); les keypointCount premiers sont des points
+    // caractristiques.
+    static bool write(const std::string& plyPath, const PlyFile& ply, const std::vector<uint32_t>& sampleIndices,
+        size_t keypointCount = 0, const WeldedMesh* welded = nullptr);
+
+    // Ouvre le cache de plyPath. Retourne false s'il n'existe pas, s'il est
+    // d'une autre version, si le PLY a chang depuis son criture ou si un
+    // indice du cache (face, slection, soudure, grille) est hors des sommets.
+    bool open(const std::string& plyPath);
+
+    bool isOpen() const { return file_.isOpen(); }
+    void close();
+
+    VertexView vertices() const;
+    // Mmes sommets quantifis: deux fois moins de mmoire  parcourir
+    QuantizedVertexView compactVertices() const;
+    const BoundingBox& bounds() const { return bounds_; }
+    // Indices des sommets proposs  la slection
+    const uint32_t* sampleIndices() const { return sampleIndices_; }
+    size_t sampleCount() const { return sampleCount_; }
+    // Nombre de points caractristiques en tte de sampleIndices
+    size_t keypointCount() const { return keypointCount_; }
+    const SpatialGrid& grid() const { return grid_; }
+    // Soudure: nouvel indice de chaque sommet du PLY, nullptr si aucun
+    // sommet n'a t fusionn
+    const uint32_t* vertexRemap() const { return vertexRemap_; }
+    size_t sourceVertexCount() const { return vertexRemap_ ? sourceVertexCount_ : vertexCount_; }
+    float weldTolerance() const { return weldTolerance_; }
+    // Faces au format cv::viz::Mesh::polygons
+    const int* polygons() const { return polygons_; }
+    size_t polygonsSize() const { return polygonsSize_; }
+    // Soudure: face du PLY de chaque face, nullptr si aucune face n'a t
+    // supprime (voir triangulatePolygons)
+    const uint32_t* sourceFaces() const { return sourceFaces_; }
+
+    // Maillage pour l'affichage Viz, directement sur les faces du cache.
+    // Avec compact, le nuage est dquantifi depuis les sommets 16 bits.
+    cv::viz::Mesh toVizMesh(bool compact = false) const;
+
+private:
+    MappedFile file_;
+    const float* x_ = nullptr;
+    const float* y_ = nullptr;
+    const float* z_ = nullptr;
+    const uint16_t* qx_ = nullptr;
+    const uint16_t* qy_ = nullptr;
+    const uint16_t* qz_ = nullptr;
+    cv::Point3f quantizationStep_;
+    size_t vertexCount_ = 0;
+    const int* polygons_ = nullptr;
+    size_t polygonsSize_ = 0;
+    const uint32_t* sourceFaces_ = nullptr;
+    const uint32_t* sampleIndices_ = nullptr;
+    size_t sampleCount_ = 0;
+    size_t keypointCount_ = 0;
+    const uint32_t* vertexRemap_ = nullptr;
+    size_t sourceVertexCount_ = 0;
+    float weldTolerance_ = 0.f;
+    BoundingBox bounds_;
+    SpatialGrid grid_;
+};
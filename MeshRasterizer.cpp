@@ -0,0 +1,308 @@
+#include "MeshRasterizer.h"
+#include "Parallel.h"
+#include "PlyReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+const int tileSize = 64;
+const float minDepth = 1e-6f;
+const float nearDepthRatio = 1e-3f;         // plan proche: fraction de la profondeur du sommet le plus lointain
+const float occlusionDepthRatio = 0.02f;    // saut de profondeur relatif marquant un bord d'occultation
+const uint32_t clippedFlag = 0x80000000u;   // entre de tuile dsignant un triangle dcoup
+
+// Morceau d'un triangle dcoup par le plan proche: u, v, profondeur
+struct ClippedTriangle {
+    cv::Vec3f v[3];
+    uint32_t triangle;
+};
+
+// Fonction d'arte: positive si p est  gauche de (a, b)
+inline float edge(float ax, float ay, float bx, float by, float px, float py) {
+    return (px - ax) * (by - ay) - (py - ay) * (bx - ax);
+}
+
+// Mme fonction value dans un ordre fixe des extrmits: deux triangles qui
+// partagent l'arte obtiennent exactement des valeurs opposes
+inline float sharedEdge(const cv::Vec3f& a, const cv::Vec3f& b, float px, float py) {
+    if (a[0] < b[0] || (a[0] == b[0] && a[1] < b[1])) {
+        return edge(a[0], a[1], b[0], b[1], px, py);
+    }
+    return -edge(b[0], b[1], a[0], a[1], px, py);
+}
+
+// Rgle haut-gauche: un pixel exactement sur l'arte (a, b), intrieur 
+// gauche, n'appartient au triangle que si c'est une arte haute ou gauche
+inline bool topLeft(const cv::Vec3f& a, const cv::Vec3f& b) {
+    float dx = b[0] - a[0], dy = b[1] - a[1];
+    return dy > 0.f || (dy == 0.f && dx < 0.f);
+}
+}
+
+MeshRasterizer::MeshRasterizer(const VertexView& vertices, const int* polygons, size_t polygonsSize,
+    const uint32_t* sourceFaces)
+    : vertices_(vertices) {
+    triangulatePolygons(polygons, polygonsSize, vertices.size(), triangles_, triangleFaces_, sourceFaces);
+    CV_Assert(triangles_.size() < clippedFlag);
+}
+
+void MeshRasterizer::render(const ProjectionParams& params, RenderBuffers& buffers) const {
+    const int width = params.width, height = params.height;
+    buffers.depth.create(height, width, CV_32F);
+    buffers.triangles.create(height, width, CV_32S);
+    buffers.depth.setTo(cv::Scalar(std::numeric_limits<float>::infinity()));
+    buffers.triangles.setTo(cv::Scalar(-1));
+
+    // 1. Projection des sommets. La profondeur est garde mme derrire la
+    // camra, pour le dcoupage; la plus grande fixe le plan proche.
+    const int threads = parallelThreadCount();
+    std::vector<cv::Vec3f>& projected = buffers.projected;
+    projected.resize(vertices_.size());
+    std::vector<float> farthest(threads, 0.f);
+#pragma omp parallel
+    {
+        float& localFarthest = farthest[parallelThreadIndex()];
+#pragma omp for
+        for (long long i = 0; i < (long long)vertices_.size(); i++) {
+            cv::Point3f p = vertices_[(size_t)i];
+            float u = 0.f, v = 0.f, depth = 0.f;
+            projectPoint(params, p.x, p.y, p.z, u, v, depth);
+            projected[i] = cv::Vec3f(u, v, depth);
+            if (depth > localFarthest) {
+                localFarthest = depth;
+            }
+        }
+    }
+    const float nearDepth = std::max(minDepth, nearDepthRatio * *std::max_element(farthest.begin(), farthest.end()));
+
+    // 2. Rpartition des triangles par tuile, une liste par thread et par
+    // tuile (OpenMP 2.0: pas de tableaux partags en criture). Les triangles
+    // qui traversent le plan proche sont dcoups en un ou deux morceaux,
+    // gards dans une liste par thread.
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    const int tileCount = tilesX * tilesY;
+    std::vector<std::vector<std::vector<uint32_t>>> bins(threads, std::vector<std::vector<uint32_t>>(tileCount));
+    std::vector<std::vector<ClippedTriangle>> clipped(threads);
+#pragma omp parallel
+    {
+        std::vector<std::vector<uint32_t>>& local = bins[parallelThreadIndex()];
+        std::vector<ClippedTriangle>& localClipped = clipped[parallelThreadIndex()];
+        auto bin = [&](const cv::Vec3f& a, const cv::Vec3f& b, const cv::Vec3f& c, uint32_t entry) {
+            float minU = std::min(a[0], std::min(b[0], c[0])), maxU = std::max(a[0], std::max(b[0], c[0]));
+            float minV = std::min(a[1], std::min(b[1], c[1])), maxV = std::max(a[1], std::max(b[1], c[1]));
+            // Hors de l'image (ou coordonnes non finies)
+            if (!(maxU >= 0.f && minU <= width - 1.f && maxV >= 0.f && minV <= height - 1.f)) {
+                return;
+            }
+            int tx0 = (int)std::ceil(std::max(minU, 0.f)) / tileSize;
+            int tx1 = (int)std::floor(std::min(maxU, width - 1.f)) / tileSize;
+            int ty0 = (int)std::ceil(std::max(minV, 0.f)) / tileSize;
+            int ty1 = (int)std::floor(std::min(maxV, height - 1.f)) / tileSize;
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    local[ty * tilesX + tx].push_back(entry);
+                }
+            }
+        };
+
+#pragma omp for
+        for (long long t = 0; t < (long long)triangles_.size(); t++) {
+            const cv::Vec3i& triangle = triangles_[t];
+            int inFront = 0;
+            for (int k = 0; k < 3; k++) {
+                inFront += projected[triangle[k]][2] >= nearDepth ? 1 : 0;
+            }
+            if (inFront == 3) {
+                bin(projected[triangle[0]], projected[triangle[1]], projected[triangle[2]], (uint32_t)t);
+                continue;
+            }
+            if (inFront == 0) {
+                continue;
+            }
+
+            // Dcoupage (Sutherland-Hodgman) contre profondeur >= nearDepth. La
+            // profondeur est affine dans le repre du modle: l'intersection y
+            // est interpole puis projete, depuis l'extrmit de plus petit
+            // indice pour qu'une arte partage donne le mme point.
+            cv::Vec3f polygon[4];
+            int size = 0;
+            for (int k = 0; k < 3; k++) {
+                int i = triangle[k], j = triangle[(k + 1) % 3];
+                bool iFront = projected[i][2] >= nearDepth, jFront = projected[j][2] >= nearDepth;
+                if (iFront) {
+                    polygon[size++] = projected[i];
+                }
+                if (iFront != jFront) {
+                    int first = std::min(i, j), second = std::max(i, j);
+                    float ratio = (nearDepth - projected[first][2]) / (projected[second][2] - projected[first][2]);
+                    cv::Point3f p = vertices_[first] + (vertices_[second] - vertices_[first]) * ratio;
+                    float u = 0.f, v = 0.f, depth = 0.f;
+                    projectPoint(params, p.x, p.y, p.z, u, v, depth);
+                    polygon[size++] = cv::Vec3f(u, v, std::max(depth, nearDepth));
+                }
+            }
+            for (int k = 1; k + 1 < size; k++) {
+                ClippedTriangle piece = { { polygon[0], polygon[k], polygon[k + 1] }, (uint32_t)t };
+                bin(piece.v[0], piece.v[1], piece.v[2], clippedFlag | (uint32_t)localClipped.size());
+                localClipped.push_back(piece);
+            }
+        }
+    }
+
+    // 3. Rastrisation tuile par tuile. La profondeur est interpole en 1/z,
+    // linaire dans l'image: le plus grand 1/z est le plus proche.
+#pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < tileCount; tile++) {
+        const int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+        const int x1 = std::min(width, x0 + tileSize), y1 = std::min(height, y0 + tileSize);
+        float inverseDepth[tileSize * tileSize];
+        int visible[tileSize * tileSize];
+        std::fill(inverseDepth, inverseDepth + tileSize * tileSize, 0.f);
+        std::fill(visible, visible + tileSize * tileSize, -1);
+        bool touched = false;
+
+        auto rasterize = [&](const cv::Vec3f& a, const cv::Vec3f& b, const cv::Vec3f& c, int id) {
+            float area = edge(a[0], a[1], b[0], b[1], c[0], c[1]);
+            if (std::abs(area) < 1e-12f) {
+                return;
+            }
+            // Triangle orient pour que l'intrieur soit positif
+            float sign = area > 0.f ? 1.f : -1.f;
+            float invArea = 1.f / std::abs(area);
+            bool topLeftA = area > 0.f ? topLeft(b, c) : topLeft(c, b);
+            bool topLeftB = area > 0.f ? topLeft(c, a) : topLeft(a, c);
+            bool topLeftC = area > 0.f ? topLeft(a, b) : topLeft(b, a);
+            float ia = 1.f / a[2], ib = 1.f / b[2], ic = 1.f / c[2];
+            // Bote du triangle borne  la tuile avant conversion en entiers
+            int px0 = (int)std::ceil(std::max((float)x0, std::min(a[0], std::min(b[0], c[0]))));
+            int px1 = (int)std::floor(std::min(x1 - 1.f, std::max(a[0], std::max(b[0], c[0]))));
+            int py0 = (int)std::ceil(std::max((float)y0, std::min(a[1], std::min(b[1], c[1]))));
+            int py1 = (int)std::floor(std::min(y1 - 1.f, std::max(a[1], std::max(b[1], c[1]))));
+
+            for (int y = py0; y <= py1; y++) {
+                float* rowDepth = inverseDepth + (y - y0) * tileSize;
+                int* rowVisible = visible + (y - y0) * tileSize;
+                for (int x = px0; x <= px1; x++) {
+                    float ea = sign * sharedEdge(b, c, (float)x, (float)y);
+                    float eb = sign * sharedEdge(c, a, (float)x, (float)y);
+                    float ec = sign * sharedEdge(a, b, (float)x, (float)y);
+                    if (!(ea > 0.f || (ea == 0.f && topLeftA)) || !(eb > 0.f || (eb == 0.f && topLeftB)) ||
+                        !(ec > 0.f || (ec == 0.f && topLeftC))) {
+                        continue;
+                    }
+                    float inv = (ea * ia + eb * ib + ec * ic) * invArea;
+                    if (inv > rowDepth[x - x0]) {
+                        rowDepth[x - x0] = inv;
+                        rowVisible[x - x0] = id;
+                        touched = true;
+                    }
+                }
+            }
+        };
+
+        for (int thread = 0; thread < threads; thread++) {
+            for (uint32_t entry : bins[thread][tile]) {
+                if (entry & clippedFlag) {
+                    const ClippedTriangle& piece = clipped[thread][entry & ~clippedFlag];
+                    rasterize(piece.v[0], piece.v[1], piece.v[2], (int)piece.triangle);
+                }
+                else {
+                    const cv::Vec3i& t = triangles_[entry];
+                    rasterize(projected[t[0]], projected[t[1]], projected[t[2]], (int)entry);
+                }
+            }
+        }
+
+        if (!touched) {
+            continue;
+        }
+        for (int y = y0; y < y1; y++) {
+            float* depthRow = buffers.depth.ptr<float>(y);
+            int* triangleRow = buffers.triangles.ptr<int>(y);
+            for (int x = x0; x < x1; x++) {
+                int k = (y - y0) * tileSize + (x - x0);
+                if (visible[k] >= 0) {
+                    depthRow[x] = 1.f / inverseDepth[k];
+                    triangleRow[x] = visible[k];
+                }
+            }
+        }
+    }
+}
+
+cv::Vec3f MeshRasterizer::faceNormal(size_t triangle, const ProjectionParams& params) const {
+    const cv::Vec3i& t = triangles_[triangle];
+    cv::Point3f p0 = vertices_[t[0]], p1 = vertices_[t[1]], p2 = vertices_[t[2]];
+    cv::Point3f n = (p1 - p0).cross(p2 - p0);
+    const float* r = params.r;
+    cv::Vec3f camera(r[0] * n.x + r[1] * n.y + r[2] * n.z, r[3] * n.x + r[4] * n.y + r[5] * n.z,
+        r[6] * n.x + r[7] * n.y + r[8] * n.z);
+    float length = std::sqrt(camera.dot(camera));
+    if (!(length > 0.f)) {
+        return cv::Vec3f(0.f, 0.f, 0.f);
+    }
+
+    // Oriente vers la camra: oppose au rayon qui va du centre optique au sommet
+    cv::Vec3f ray(r[0] * p0.x + r[1] * p0.y + r[2] * p0.z + params.t[0],
+        r[3] * p0.x + r[4] * p0.y + r[5] * p0.z + params.t[1], r[6] * p0.x + r[7] * p0.y + r[8] * p0.z + params.t[2]);
+    return camera * ((camera.dot(ray) > 0.f ? -1.f : 1.f) / length);
+}
+
+void MeshRasterizer::normalMap(const RenderBuffers& buffers, const ProjectionParams& params, cv::Mat& normals) const {
+    normals.create(buffers.triangles.rows, buffers.triangles.cols, CV_32FC3);
+#pragma omp parallel for
+    for (int y = 0; y < normals.rows; y++) {
+        const int* ids = buffers.triangles.ptr<int>(y);
+        cv::Vec3f* out = normals.ptr<cv::Vec3f>(y);
+        for (int x = 0; x < normals.cols; x++) {
+            out[x] = ids[x] >= 0 ? faceNormal((size_t)ids[x], params) : cv::Vec3f(0.f, 0.f, 0.f);
+        }
+    }
+}
+
+void MeshRasterizer::drawOverlay(cv::Mat& image, const RenderBuffers& buffers, const ProjectionParams& params,
+    const cv::Scalar& surfaceColor, const cv::Scalar& edgeColor, double alpha) const {
+    CV_Assert(image.type() == CV_8UC3 && buffers.triangles.size() == image.size());
+    const float a = (float)alpha;
+#pragma omp parallel for
+    for (int y = 0; y < image.rows; y++) {
+        unsigned char* pixel = image.ptr<unsigned char>(y);
+        const int* ids = buffers.triangles.ptr<int>(y);
+        const float* depth = buffers.depth.ptr<float>(y);
+        for (int x = 0; x < image.cols; x++, pixel += 3) {
+            int id = ids[x];
+            if (id < 0) {
+                continue;
+            }
+
+            // Contour: un voisin sans surface ou nettement plus loin
+            bool contour = false;
+            const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+            for (int n = 0; n < 4 && !contour; n++) {
+                int nx = x + dx[n], ny = y + dy[n];
+                if (nx < 0 || ny < 0 || nx >= image.cols || ny >= image.rows) {
+                    continue;
+                }
+                float neighbour = buffers.depth.ptr<float>(ny)[nx];
+                contour = neighbour - depth[x] > occlusionDepthRatio * depth[x];
+            }
+            if (contour) {
+                for (int c = 0; c < 3; c++) {
+                    pixel[c] = (unsigned char)edgeColor[c];
+                }
+                continue;
+            }
+
+            // Ombrage: cosinus entre la normale et l'axe optique
+            cv::Vec3f n = faceNormal((size_t)id, params);
+            float shade = n.dot(n) > 0.f ? 0.35f + 0.65f * std::abs(n[2]) : 1.f;
+            for (int c = 0; c < 3; c++) {
+                pixel[c] = (unsigned char)(a * shade * (float)surfaceColor[c] + (1.f - a) * pixel[c] + 0.5f);
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ProjectionKernel.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Rsultat d'un rendu, rutilisable d'une pose  l'autre
+struct RenderBuffers {
+    cv::Mat depth;        // CV_32F: profondeur camra du point visible, +inf sans surface
+    cv::Mat triangles;    // CV_32S: triangle visible, -1 sans surface
+    std::vector<cv::Vec3f> projected;    // u, v, profondeur de chaque sommet (tampon interne)
+};
+
+// Rendu logiciel des faces du maillage avec tampon de profondeur, pour ne
+// superposer  l'image que les surfaces rellement visibles depuis la pose.
+// Les triangles sont rpartis par tuiles de l'image, puis chaque tuile est
+// rastrise par un seul thread (aucune criture partage). La distorsion est
+// applique aux sommets, les artes restent droites dans l'image. Les triangles
+// qui traversent le plan proche (1/1000 de la profondeur du sommet le plus
+// lointain) sont dcoups, pour les vues prises depuis l'intrieur d'une pice.
+// Rgle haut-gauche: un pixel sur une arte partage n'est couvert qu'une fois.
+class MeshRasterizer {
+public:
+    MeshRasterizer() = default;
+    // polygons au format cv::viz::Mesh::polygons (n, i0, ..., i(n-1), ...),
+    // dcoups en ventail. vertices doit rester valide.
+    // sourceFaces: voir triangulatePolygons (faces du PLY aprs soudure).
+    MeshRasterizer(const VertexView& vertices, const int* polygons, size_t polygonsSize,
+        const uint32_t* sourceFaces = nullptr);
+
+    size_t triangleCount() const { return triangles_.size(); }
+    bool empty() const { return triangles_.empty(); }
+    const cv::Vec3i& triangle(size_t i) const { return triangles_[i]; }
+    // Face d'origine (indice dans polygons, ou sourceFaces[indice]) d'un triangle
+    size_t face(size_t triangle) const { return triangleFaces_.empty() ? triangle : triangleFaces_[triangle]; }
+
+    void render(const ProjectionParams& params, RenderBuffers& buffers) const;
+
+    // Normale unitaire d'un triangle dans le repre camra, tourne vers la
+    // camra (nulle pour un triangle dgnr)
+    cv::Vec3f faceNormal(size_t triangle, const ProjectionParams& params) const;
+
+    // Normale de la face visible de chaque pixel d'un rendu: CV_32FC3, nulle
+    // sans surface
+    void normalMap(const RenderBuffers& buffers, const ProjectionParams& params, cv::Mat& normals) const;
+
+    // Surfaces visibles ombres selon leur orientation (opacit alpha) et
+    // contours (silhouette et bords d'occultation) sur image (CV_8UC3)
+    void drawOverlay(cv::Mat& image, const RenderBuffers& buffers, const ProjectionParams& params,
+        const cv::Scalar& surfaceColor, const cv::Scalar& edgeColor, double alpha) const;
+
+private:
+    VertexView vertices_;
+    std::vector<cv::Vec3i> triangles_;
+    std::vector<uint32_t> triangleFaces_;    // vide si le triangle i vient de la face i
+};
@@ -0,0 +1,281 @@
+#include "MeshWelding.h"
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace {
+const uint64_t emptyKey = std::numeric_limits<uint64_t>::max();
+const int keyBits = 21;
+const int maxCoord = (1 << keyBits) - 1;
+const float cellsPerTolerance = 8.f;    // cellules plus grandes que la tolrance: voisines rarement visites
+
+inline uint64_t packKey(int x, int y, int z) {
+    return ((uint64_t)z << (2 * keyBits)) | ((uint64_t)y << keyBits) | (uint64_t)x;
+}
+
+// Cellule occupe: cl, effectif, puis fin de ses sommets dans le tableau
+// tri (16 octets: une seule ligne de cache par accs)
+struct Cell {
+    std::atomic<uint64_t> key;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> cursor;
+};
+
+// Table partage  adressage ouvert des cellules occupes
+class CellTable {
+public:
+    explicit CellTable(size_t count) {
+        capacity_ = 16;
+        while (capacity_ < count + count / 2) {
+            capacity_ *= 2;
+        }
+        cells_.reset(new Cell[capacity_]);
+#pragma omp parallel for
+        for (long long s = 0; s < (long long)capacity_; s++) {
+            cells_[s].key.store(emptyKey, std::memory_order_relaxed);
+            cells_[s].count.store(0, std::memory_order_relaxed);
+            cells_[s].cursor.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+    Cell& operator[](size_t slot) { return cells_[slot]; }
+    const Cell& operator[](size_t slot) const { return cells_[slot]; }
+
+    // Cellule de la cl, cre si besoin (utilisable depuis plusieurs threads)
+    Cell& insert(uint64_t key) {
+        size_t slot = hash(key);
+        for (;;) {
+            uint64_t current = cells_[slot].key.load(std::memory_order_relaxed);
+            if (current == emptyKey &&
+                cells_[slot].key.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+                return cells_[slot];
+            }
+            if (current == key) {
+                return cells_[slot];
+            }
+            slot = (slot + 1) & (capacity_ - 1);
+        }
+    }
+
+    // Cellule de la cl, nullptr si elle est vide (aprs les insertions)
+    const Cell* find(uint64_t key) const {
+        size_t slot = hash(key);
+        for (;;) {
+            uint64_t current = cells_[slot].key.load(std::memory_order_relaxed);
+            if (current == key) {
+                return &cells_[slot];
+            }
+            if (current == emptyKey) {
+                return nullptr;
+            }
+            slot = (slot + 1) & (capacity_ - 1);
+        }
+    }
+
+private:
+    size_t hash(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 20) & (capacity_ - 1); }
+
+    size_t capacity_ = 0;
+    std::unique_ptr<Cell[]> cells_;
+};
+}
+
+void weldVertices(const VertexView& vertices, float relativeTolerance, std::vector<cv::Point3f>& welded,
+    std::vector<uint32_t>& remap) {
+    CV_Assert(vertices.size() < std::numeric_limits<uint32_t>::max());
+    const size_t count = vertices.size();
+    welded.clear();
+    remap.clear();
+    if (count < 2) {
+        return;
+    }
+
+    BoundingBox bounds = computeBoundingBox(vertices);
+    cv::Point3f extent = bounds.size();
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    const float tolerance = std::max(0.f, relativeTolerance) * std::sqrt(extent.dot(extent));
+    const float tolerance2 = tolerance * tolerance;
+    float step = std::max(cellsPerTolerance * tolerance, maxExtent / (float)(1 << (keyBits - 1)));
+    if (!(step > 0.f)) {
+        step = 1.f;
+    }
+    const cv::Point3f origin = bounds.min;
+    const float inverseStep = 1.f / step;
+    auto cellCoord = [&](float value, float low) {
+        return std::max(0, std::min(maxCoord, (int)std::floor((value - low) * inverseStep)));
+    };
+    auto cellKey = [&](const cv::Point3f& p) {
+        return packKey(cellCoord(p.x, origin.x), cellCoord(p.y, origin.y), cellCoord(p.z, origin.z));
+    };
+
+    // 1. Sommets rangs par cellule (tri par dnombrement), avec leur
+    // position pour que la comparaison dans une cellule reste contigu.
+    // L'ordre dans une cellule n'importe pas.
+    CellTable table(count);
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)count; i++) {
+        table.insert(cellKey(vertices[(size_t)i])).count.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint32_t offset = 0;
+    for (size_t s = 0; s < table.capacity(); s++) {
+        table[s].cursor.store(offset, std::memory_order_relaxed);
+        offset += table[s].count.load(std::memory_order_relaxed);
+    }
+    std::vector<uint32_t> members(count);
+    std::vector<cv::Point3f> positions(count);
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)count; i++) {
+        cv::Point3f p = vertices[(size_t)i];
+        uint32_t k = table.insert(cellKey(p)).cursor.fetch_add(1, std::memory_order_relaxed);
+        members[k] = (uint32_t)i;
+        positions[k] = p;
+    }
+
+    // 2. Pour chaque sommet, cellule par cellule: sommet de plus petit indice
+    //  moins de la tolrance, dans sa cellule et dans les voisines du ct
+    // des bords  moins de la tolrance
+    remap.resize(count);
+#pragma omp parallel for schedule(dynamic, 4096)
+    for (long long s = 0; s < (long long)table.capacity(); s++) {
+        const Cell& cell = table[(size_t)s];
+        uint32_t cellEnd = cell.cursor.load(std::memory_order_relaxed);
+        uint32_t cellBegin = cellEnd - cell.count.load(std::memory_order_relaxed);
+        for (uint32_t k = cellBegin; k < cellEnd; k++) {
+            const cv::Point3f p = positions[k];
+            uint32_t representative = members[k];
+            for (uint32_t m = cellBegin; m < cellEnd; m++) {
+                if (members[m] < representative) {
+                    cv::Point3f d = positions[m] - p;
+                    if (d.dot(d) <= tolerance2) {
+                        representative = members[m];
+                    }
+                }
+            }
+
+            int c[3] = { cellCoord(p.x, origin.x), cellCoord(p.y, origin.y), cellCoord(p.z, origin.z) };
+            float local[3] = { (p.x - origin.x) * inverseStep - c[0], (p.y - origin.y) * inverseStep - c[1],
+                (p.z - origin.z) * inverseStep - c[2] };
+            int low[3], high[3];
+            for (int axis = 0; axis < 3; axis++) {
+                low[axis] = c[axis] > 0 && local[axis] * step <= tolerance ? -1 : 0;
+                high[axis] = c[axis] < maxCoord && (1.f - local[axis]) * step <= tolerance ? 1 : 0;
+            }
+            for (int dz = low[2]; dz <= high[2]; dz++) {
+                for (int dy = low[1]; dy <= high[1]; dy++) {
+                    for (int dx = low[0]; dx <= high[0]; dx++) {
+                        if (dx == 0 && dy == 0 && dz == 0) {
+                            continue;
+                        }
+                        const Cell* neighbour = table.find(packKey(c[0] + dx, c[1] + dy, c[2] + dz));
+                        if (neighbour == nullptr) {
+                            continue;
+                        }
+                        uint32_t end = neighbour->cursor.load(std::memory_order_relaxed);
+                        for (uint32_t m = end - neighbour->count.load(std::memory_order_relaxed); m < end; m++) {
+                            if (members[m] < representative) {
+                                cv::Point3f d = positions[m] - p;
+                                if (d.dot(d) <= tolerance2) {
+                                    representative = members[m];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            remap[members[k]] = representative;
+        }
+    }
+    members.clear();
+    members.shrink_to_fit();
+    positions.clear();
+    positions.shrink_to_fit();
+
+    size_t representatives = 0;
+    for (size_t i = 0; i < count; i++) {
+        representatives += remap[i] == (uint32_t)i ? 1 : 0;
+    }
+    if (representatives == count) {
+        remap.clear();
+        remap.shrink_to_fit();
+        return;
+    }
+
+    // 3. Numrotation des reprsentants dans l'ordre. Un sommet est rattach
+    //  un indice plus petit, dont l'entre est donc dj renumrote: les
+    // chanes se referment sur leur premier sommet.
+    welded.reserve(representatives);
+    for (size_t i = 0; i < count; i++) {
+        if (remap[i] == (uint32_t)i) {
+            remap[i] = (uint32_t)welded.size();
+            welded.push_back(vertices[i]);
+        }
+        else {
+            remap[i] = remap[remap[i]];
+        }
+    }
+}
+
+size_t remapPolygons(std::vector<int>& polygons, const std::vector<uint32_t>& remap,
+    std::vector<uint32_t>* sourceFaces) {
+    size_t read = 0, write = 0, removed = 0;
+    std::vector<uint32_t> sources;
+    for (size_t face = 0; read < polygons.size(); face++) {
+        int n = polygons[read];
+        size_t header = write++;
+        int kept = 0;
+        for (int k = 0; k < n; k++) {
+            int index = (int)remap[polygons[read + 1 + k]];
+            if (kept > 0 && polygons[write - 1] == index) {
+                continue;
+            }
+            polygons[write++] = index;
+            kept++;
+        }
+        if (kept > 1 && polygons[write - 1] == polygons[header + 1]) {
+            write--;
+            kept--;
+        }
+        read += 1 + n;
+        if (kept < 3) {
+            write = header;
+            removed++;
+            continue;
+        }
+        polygons[header] = kept;
+        if (sourceFaces != nullptr) {
+            sources.push_back((uint32_t)face);
+        }
+    }
+    polygons.resize(write);
+    if (sourceFaces != nullptr) {
+        sourceFaces->clear();
+        if (removed > 0) {
+            sourceFaces->swap(sources);
+        }
+    }
+    return removed;
+}
+
+WeldedMesh weldMesh(const VertexView& vertices, std::vector<int> polygons, float relativeTolerance) {
+    WeldedMesh mesh;
+    mesh.polygons.swap(polygons);
+    if (relativeTolerance <= 0.f) {
+        return mesh;
+    }
+    auto start = std::chrono::steady_clock::now();
+    mesh.tolerance = relativeTolerance;
+    weldVertices(vertices, relativeTolerance, mesh.vertices, mesh.vertexRemap);
+    if (!mesh.vertexRemap.empty()) {
+        remapPolygons(mesh.polygons, mesh.vertexRemap, &mesh.sourceFaces);
+    }
+    mesh.report.verticesBefore = vertices.size();
+    mesh.report.verticesAfter = mesh.view(vertices).size();
+    mesh.report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return mesh;
+}
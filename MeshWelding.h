@@ -0,0 +1,54 @@
+#pragma once
+
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bilan d'une soudure, pour l'affichage
+struct WeldReport {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    double seconds = 0.0;
+};
+
+// Soudure des sommets confondus: chaque sommet est rattach au sommet de plus
+// petit indice situ  moins de relativeTolerance x diagonale du modle (les
+// doublons exacts, rpts par face  l'export, le sont toujours), et les
+// chanes de rattachement sont suivies jusqu' leur dbut. Les voisins sont
+// cherchs dans une grille de hachage, cellules adjacentes comprises prs des
+// bords. Le reprsentant garde sa position d'origine, l'ordre des
+// reprsentants est conserv et le rsultat ne dpend pas du nombre de threads.
+// remap[i] reoit le nouvel indice du sommet i. Sans aucun doublon, welded et
+// remap restent vides (pas de copie des sommets).
+void weldVertices(const VertexView& vertices, float relativeTolerance, std::vector<cv::Point3f>& welded,
+    std::vector<uint32_t>& remap);
+
+// Applique remap aux faces (format cv::viz::Mesh::polygons), sur place: les
+// sommets conscutifs devenus identiques sont retirs, puis les faces de
+// moins de trois sommets. Retourne le nombre de faces supprimes.
+// sourceFaces (facultatif) reoit l'indice d'origine de chaque face garde, et
+// reste vide si aucune face n'est supprime.
+size_t remapPolygons(std::vector<int>& polygons, const std::vector<uint32_t>& remap,
+    std::vector<uint32_t>* sourceFaces = nullptr);
+
+// Maillage soud gard en mmoire pour la session (voir weldMesh)
+struct WeldedMesh {
+    std::vector<cv::Point3f> vertices;    // vide sans doublon: les sommets d'origine restent valables
+    std::vector<uint32_t> vertexRemap;    // nouvel indice de chaque sommet d'origine, vide sans doublon
+    std::vector<int> polygons;            // faces renumrotes (format cv::viz::Mesh::polygons)
+    std::vector<uint32_t> sourceFaces;    // face d'origine de chaque face, vide si aucune n'a t supprime
+    float tolerance = 0.f;                // tolrance relative utilise, 0 sans soudure
+    WeldReport report;
+
+    // Sommets du maillage soud (ceux d'origine sans doublon)
+    VertexView view(const VertexView& original) const {
+        return vertices.empty() ? original : VertexView(vertices);
+    }
+};
+
+// Soudure d'un maillage (sommets et faces) juste aprs son chargement.
+// relativeTolerance <= 0: aucune soudure, les faces sont gardes telles quelles.
+WeldedMesh weldMesh(const VertexView& vertices, std::vector<int> polygons, float relativeTolerance);
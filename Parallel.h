@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Petites aides autour d'OpenMP. Sans OpenMP les pragmas sont ignors et le
+// code s'excute simplement sur un seul thread.
+inline int parallelThreadCount() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int parallelThreadIndex() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// Boucle parallle  vol de travail, pour des itrations de dures trs
+// ingales (une pose peut coter 100 fois plus qu'une autre). Chaque thread
+// part d'une tranche contigu de [0, count); quand la sienne est vide, il prend
+// la moiti restante de la tranche d'un autre thread. f(index, thread) reoit
+// l'indice du thread (0 .. threadCount-1) pour utiliser ses propres tampons.
+// threadCount <= 0: un thread par coeur. Le thread appelant participe.
+template <typename F>
+void parallelForStealing(size_t count, int threadCount, F f) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = (int)std::min<size_t>((size_t)threadCount, std::max<size_t>(1, count));
+
+    struct alignas(64) Range {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    std::vector<Range> ranges(threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        ranges[t].begin = count * t / threadCount;
+        ranges[t].end = count * (t + 1) / threadCount;
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto worker = [&](int thread) {
+        Range& own = ranges[thread];
+        for (;;) {
+            size_t index = count;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.begin < own.end) {
+                    index = own.begin++;
+                }
+            }
+            if (index < count) {
+                try {
+                    f(index, thread);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                continue;
+            }
+
+            // Vol: la moiti de fin de la premire tranche non vide
+            bool stolen = false;
+            for (int k = 1; k < threadCount && !stolen; k++) {
+                Range& victim = ranges[(thread + k) % threadCount];
+                size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    if (victim.begin >= victim.end) {
+                        continue;
+                    }
+                    end = victim.end;
+                    begin = victim.end - (victim.end - victim.begin + 1) / 2;
+                    victim.end = begin;
+                }
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.begin = begin;
+                own.end = end;
+                stolen = true;
+            }
+            if (!stolen) {
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
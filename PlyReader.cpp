@@ -0,0 +1,609 @@
+#include "PlyReader.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+bool parsePlyType(const std::string& name, PlyType& type) {
+    if (name == "char" || name == "int8") type = PlyType::Int8;
+    else if (name == "uchar" || name == "uint8") type = PlyType::UInt8;
+    else if (name == "short" || name == "int16") type = PlyType::Int16;
+    else if (name == "ushort" || name == "uint16") type = PlyType::UInt16;
+    else if (name == "int" || name == "int32") type = PlyType::Int32;
+    else if (name == "uint" || name == "uint32") type = PlyType::UInt32;
+    else if (name == "float" || name == "float32") type = PlyType::Float32;
+    else if (name == "double" || name == "float64") type = PlyType::Float64;
+    else return false;
+    return true;
+}
+
+template <typename T>
+T loadValue(const char* p, bool swap) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double readBinaryValue(const char* p, PlyType type, bool swap) {
+    switch (type) {
+    case PlyType::Int8: return static_cast<double>(loadValue<int8_t>(p, swap));
+    case PlyType::UInt8: return static_cast<double>(loadValue<uint8_t>(p, swap));
+    case PlyType::Int16: return static_cast<double>(loadValue<int16_t>(p, swap));
+    case PlyType::UInt16: return static_cast<double>(loadValue<uint16_t>(p, swap));
+    case PlyType::Int32: return static_cast<double>(loadValue<int32_t>(p, swap));
+    case PlyType::UInt32: return static_cast<double>(loadValue<uint32_t>(p, swap));
+    case PlyType::Float32: return static_cast<double>(loadValue<float>(p, swap));
+    case PlyType::Float64: return loadValue<double>(p, swap);
+    }
+    return 0.0;
+}
+
+// Taille d'une liste lue dans le fichier: un type de taille sign peut donner
+// une valeur ngative, dont la conversion en size_t serait indfinie
+size_t listCount(double value) {
+    if (!(value >= 0.0) || value > static_cast<double>(std::numeric_limits<int>::max())) {
+        CV_Error(cv::Error::StsParseError, "Taille de liste PLY invalide");
+    }
+    return static_cast<size_t>(value);
+}
+
+// Avance d'un enregistrement binaire (utile pour les lments contenant des listes).
+// Les tailles sont compares  ce qui reste du fichier sans calculer p + n,
+// qui pourrait dborder avec une taille de liste aberrante.
+const char* skipBinaryRecord(const char* p, const char* end, const PlyElement& element, bool swap) {
+    for (const PlyProperty& property : element.properties) {
+        size_t typeSize = plyTypeSize(property.type);
+        size_t count = 1;
+        if (property.isList) {
+            size_t countSize = plyTypeSize(property.countType);
+            if (static_cast<size_t>(end - p) < countSize) {
+                CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu");
+            }
+            count = listCount(readBinaryValue(p, property.countType, swap));
+            p += countSize;
+        }
+        if (count > static_cast<size_t>(end - p) / typeSize) {
+            CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu");
+        }
+        p += count * typeSize;
+    }
+    return p;
+}
+
+const char* skipLine(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+}
+
+// Lecture d'un nombre ASCII avec std::from_chars (indpendant de la locale)
+bool parseAsciiNumber(const char*& p, const char* end, double& value) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+bool parseAsciiVertex(const char* p, const char* end, const PlyElement& element,
+    int ix, int iy, int iz, cv::Point3f& vertex) {
+    int maxIndex = std::max(ix, std::max(iy, iz));
+    double value = 0.0;
+    for (int k = 0; k <= maxIndex; k++) {
+        if (element.properties[k].isList) {
+            if (!parseAsciiNumber(p, end, value) || !(value >= 0.0)) {
+                return false;
+            }
+            for (size_t j = static_cast<size_t>(value); j > 0; j--) {
+                if (!parseAsciiNumber(p, end, value)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        if (!parseAsciiNumber(p, end, value)) {
+            return false;
+        }
+        if (k == ix) vertex.x = static_cast<float>(value);
+        if (k == iy) vertex.y = static_cast<float>(value);
+        if (k == iz) vertex.z = static_cast<float>(value);
+    }
+    return true;
+}
+
+// Bloc de texte align sur des dbuts de ligne
+struct LineChunk {
+    const char* begin;
+    const char* end;
+    size_t firstLine;   // numro de la premire ligne du bloc
+    size_t lineCount;
+};
+
+const size_t lineChunkSize = 4 << 20;
+
+// Dcoupe [begin, end) en blocs d'environ 4 Mo aligns sur les fins de ligne et
+// numrote leurs lignes. Les fins de ligne sont comptes en parallle, par lots
+// de blocs, jusqu' couvrir au moins "lineCount" lignes.
+std::vector<LineChunk> splitLines(const char* begin, const char* end, size_t lineCount) {
+    std::vector<LineChunk> chunks;
+    const int batchSize = 4 * parallelThreadCount();
+    size_t linesSeen = 0;
+    const char* p = begin;
+
+    while (p < end && linesSeen < lineCount) {
+        size_t batchBegin = chunks.size();
+        for (int b = 0; b < batchSize && p < end; b++) {
+            size_t length = std::min<size_t>(lineChunkSize, end - p);
+            const char* chunkEnd = skipLine(p + length - 1, end);
+            chunks.push_back({ p, chunkEnd, 0, 0 });
+            p = chunkEnd;
+        }
+
+        int batchCount = (int)(chunks.size() - batchBegin);
+#pragma omp parallel for
+        for (int b = 0; b < batchCount; b++) {
+            LineChunk& chunk = chunks[batchBegin + b];
+            chunk.lineCount = (size_t)std::count(chunk.begin, chunk.end, '\n');
+            if (chunk.end == end && chunk.end[-1] != '\n') {
+                chunk.lineCount++;  // dernire ligne sans retour  la ligne
+            }
+        }
+
+        for (size_t c = batchBegin; c < chunks.size(); c++) {
+            chunks[c].firstLine = linesSeen;
+            linesSeen += chunks[c].lineCount;
+        }
+    }
+    return chunks;
+}
+
+// Position de la ligne "lineCount"  partir de begin
+const char* skipAsciiLines(const char* begin, const char* end, size_t lineCount) {
+    if (lineCount == 0) {
+        return begin;
+    }
+    std::vector<LineChunk> chunks = splitLines(begin, end, lineCount);
+    for (const LineChunk& chunk : chunks) {
+        if (lineCount < chunk.firstLine + chunk.lineCount) {
+            const char* p = chunk.begin;
+            for (size_t i = chunk.firstLine; i < lineCount; i++) {
+                p = skipLine(p, chunk.end);
+            }
+            return p;
+        }
+    }
+    if (chunks.empty() || chunks.back().firstLine + chunks.back().lineCount < lineCount) {
+        CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu");
+    }
+    return chunks.back().end;
+}
+
+} // namespace
+
+size_t plyTypeSize(PlyType type) {
+    switch (type) {
+    case PlyType::Int8: case PlyType::UInt8: return 1;
+    case PlyType::Int16: case PlyType::UInt16: return 2;
+    case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+int PlyElement::findProperty(const std::string& propertyName) const {
+    for (size_t i = 0; i < properties.size(); i++) {
+        if (properties[i].name == propertyName) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int PlyHeader::findElement(const std::string& elementName) const {
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].name == elementName) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+PlyHeader parsePlyHeader(const char* data, size_t size) {
+    PlyHeader header;
+    const char* end = data + size;
+    const char* p = data;
+    bool formatFound = false;
+    bool first = true;
+
+    while (p < end) {
+        const char* next = skipLine(p, end);
+        std::string line(p, next);
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        p = next;
+
+        if (first) {
+            if (line != "ply") {
+                CV_Error(cv::Error::StsParseError, "Ce n'est pas un fichier PLY");
+            }
+            first = false;
+            continue;
+        }
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii") header.format = PlyFormat::Ascii;
+            else if (format == "binary_little_endian") header.format = PlyFormat::BinaryLittleEndian;
+            else if (format == "binary_big_endian") header.format = PlyFormat::BinaryBigEndian;
+            else CV_Error(cv::Error::StsParseError, "Format PLY inconnu: " + format);
+            formatFound = true;
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            tokens >> element.name >> element.count;
+            if (tokens.fail()) {
+                CV_Error(cv::Error::StsParseError, "Ligne element invalide: " + line);
+            }
+            header.elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            if (header.elements.empty()) {
+                CV_Error(cv::Error::StsParseError, "Proprit PLY hors d'un lment: " + line);
+            }
+            PlyProperty property;
+            std::string typeName;
+            tokens >> typeName;
+            if (typeName == "list") {
+                std::string countType, itemType;
+                tokens >> countType >> itemType;
+                property.isList = true;
+                if (!parsePlyType(countType, property.countType) || !parsePlyType(itemType, property.type)) {
+                    CV_Error(cv::Error::StsParseError, "Type de liste PLY inconnu: " + line);
+                }
+            }
+            else if (!parsePlyType(typeName, property.type)) {
+                CV_Error(cv::Error::StsParseError, "Type PLY inconnu: " + line);
+            }
+            tokens >> property.name;
+            header.elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") {
+            header.dataOffset = static_cast<size_t>(p - data);
+            if (!formatFound) {
+                CV_Error(cv::Error::StsParseError, "En-tte PLY sans ligne format");
+            }
+
+            // Positions des proprits dans un enregistrement binaire de taille fixe
+            for (PlyElement& element : header.elements) {
+                size_t offset = 0;
+                bool fixedSize = true;
+                for (PlyProperty& property : element.properties) {
+                    property.offset = offset;
+                    if (property.isList) {
+                        fixedSize = false;
+                    }
+                    offset += plyTypeSize(property.type);
+                }
+                element.stride = fixedSize ? offset : 0;
+            }
+            return header;
+        }
+        // "comment" et "obj_info" sont ignors
+    }
+
+    CV_Error(cv::Error::StsParseError, "En-tte PLY sans end_header");
+}
+
+PlyFile PlyFile::load(const std::string& path) {
+    PlyFile ply;
+    ply.file_ = MappedFile(path);
+    ply.header_ = parsePlyHeader(ply.file_.data(), ply.file_.size());
+    ply.vertexElement_ = ply.header_.findElement("vertex");
+    ply.faceElement_ = ply.header_.findElement("face");
+
+    if (ply.vertexElement_ < 0) {
+        CV_Error(cv::Error::StsParseError, "Le fichier PLY ne contient pas de sommets: " + path);
+    }
+    ply.vertexCount_ = ply.header_.elements[ply.vertexElement_].count;
+    if (ply.vertexCount_ == 0) {
+        CV_Error(cv::Error::StsParseError, "Le fichier PLY ne contient aucun sommet: " + path);
+    }
+
+    // Dbut de chaque lment dans les donnes
+    const PlyHeader& header = ply.header_;
+    const char* p = ply.file_.data() + header.dataOffset;
+    const char* end = ply.file_.data() + ply.file_.size();
+    bool swap = (header.format == PlyFormat::BinaryBigEndian) != (std::endian::native == std::endian::big);
+    for (size_t e = 0; e < header.elements.size(); e++) {
+        const PlyElement& element = header.elements[e];
+        ply.elementOffsets_.push_back(static_cast<size_t>(p - ply.file_.data()));
+        if ((int)e == std::max(ply.vertexElement_, ply.faceElement_)) {
+            break;  // les lments suivants ne sont pas utiliss
+        }
+        if (header.format == PlyFormat::Ascii) {
+            p = skipAsciiLines(p, end, element.count);
+        }
+        else if (element.stride != 0) {
+            if (element.count > static_cast<size_t>(end - p) / element.stride) {
+                CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: " + path);
+            }
+            p += element.count * element.stride;
+        }
+        else {
+            for (size_t i = 0; i < element.count; i++) {
+                p = skipBinaryRecord(p, end, element, swap);
+            }
+        }
+        if (p > end) {
+            CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: " + path);
+        }
+    }
+
+    ply.readVertices();
+    return ply;
+}
+
+const char* PlyFile::elementData(int elementIndex) const {
+    return file_.data() + elementOffsets_[elementIndex];
+}
+
+void PlyFile::readVertices() {
+    const PlyElement& element = header_.elements[vertexElement_];
+    int ix = element.findProperty("x");
+    int iy = element.findProperty("y");
+    int iz = element.findProperty("z");
+    if (ix < 0 || iy < 0 || iz < 0) {
+        CV_Error(cv::Error::StsParseError, "Les sommets PLY n'ont pas de proprits x, y, z");
+    }
+
+    const char* p = elementData(vertexElement_);
+    const char* end = file_.data() + file_.size();
+
+    if (header_.format != PlyFormat::Ascii && element.stride != 0 &&
+        vertexCount_ > static_cast<size_t>(end - p) / element.stride) {
+        CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: bloc de sommets incomplet");
+    }
+
+    // Cas courant: binaire natif, x/y/z float conscutifs -> vue directe sur le fichier
+    bool nativeBinary = header_.format == (std::endian::native == std::endian::little
+        ? PlyFormat::BinaryLittleEndian : PlyFormat::BinaryBigEndian);
+    const PlyProperty& px = element.properties[ix];
+    const PlyProperty& py = element.properties[iy];
+    const PlyProperty& pz = element.properties[iz];
+    if (nativeBinary && element.stride != 0 &&
+        px.type == PlyType::Float32 && py.type == PlyType::Float32 && pz.type == PlyType::Float32 &&
+        py.offset == px.offset + 4 && pz.offset == px.offset + 8) {
+        vertices_ = VertexView(p + px.offset, vertexCount_, element.stride);
+        return;
+    }
+
+    // Sinon conversion en cv::Point3f (ASCII, double, big-endian, listes...)
+    convertedVertices_.resize(vertexCount_);
+    if (header_.format == PlyFormat::Ascii) {
+        // Dcoupage en blocs de lignes analyss sur tous les coeurs, chaque
+        // sommet tant crit directement  sa place dans le tableau final
+        std::vector<LineChunk> chunks = splitLines(p, end, vertexCount_);
+        if (chunks.empty() || chunks.back().firstLine + chunks.back().lineCount < vertexCount_) {
+            CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: bloc de sommets incomplet");
+        }
+
+        std::atomic<bool> parseFailed(false);
+        cv::Point3f* vertices = convertedVertices_.data();
+        size_t vertexCount = vertexCount_;
+#pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < (int)chunks.size(); c++) {
+            const LineChunk& chunk = chunks[c];
+            const char* line = chunk.begin;
+            for (size_t i = chunk.firstLine; i < vertexCount && line < chunk.end; i++) {
+                const char* next = skipLine(line, chunk.end);
+                if (!parseAsciiVertex(line, next, element, ix, iy, iz, vertices[i])) {
+                    parseFailed = true;
+                    break;
+                }
+                line = next;
+            }
+        }
+        if (parseFailed) {
+            CV_Error(cv::Error::StsParseError, "Sommet PLY ASCII invalide");
+        }
+    }
+    else {
+        bool swap = !nativeBinary;
+        for (size_t i = 0; i < vertexCount_; i++) {
+            const char* record = p;
+            if (element.stride != 0) {
+                p += element.stride;
+            }
+            else {
+                p = skipBinaryRecord(p, end, element, swap);
+            }
+            // Avec des listes dans l'lment sommet, les positions ne sont plus fixes
+            float values[3] = { 0.f, 0.f, 0.f };
+            const char* q = record;
+            for (int k = 0; k < (int)element.properties.size(); k++) {
+                const PlyProperty& property = element.properties[k];
+                if (property.isList) {
+                    size_t count = listCount(readBinaryValue(q, property.countType, swap));
+                    q += plyTypeSize(property.countType) + count * plyTypeSize(property.type);
+                    continue;
+                }
+                if (k == ix) values[0] = static_cast<float>(readBinaryValue(q, property.type, swap));
+                if (k == iy) values[1] = static_cast<float>(readBinaryValue(q, property.type, swap));
+                if (k == iz) values[2] = static_cast<float>(readBinaryValue(q, property.type, swap));
+                q += plyTypeSize(property.type);
+            }
+            convertedVertices_[i] = cv::Point3f(values[0], values[1], values[2]);
+        }
+    }
+    vertices_ = VertexView(convertedVertices_);
+}
+
+std::vector<int> PlyFile::readPolygons() const {
+    std::vector<int> polygons;
+    if (faceElement_ < 0) {
+        return polygons;
+    }
+
+    const PlyElement& element = header_.elements[faceElement_];
+    int indicesProperty = element.findProperty("vertex_indices");
+    if (indicesProperty < 0) {
+        indicesProperty = element.findProperty("vertex_index");
+    }
+    if (indicesProperty < 0 || !element.properties[indicesProperty].isList) {
+        CV_Error(cv::Error::StsParseError, "Les faces PLY n'ont pas de liste vertex_indices");
+    }
+
+    const char* p = elementData(faceElement_);
+    const char* end = file_.data() + file_.size();
+    bool swap = (header_.format == PlyFormat::BinaryBigEndian) != (std::endian::native == std::endian::big);
+    polygons.reserve(element.count * 4);
+
+    for (size_t f = 0; f < element.count; f++) {
+        if (header_.format == PlyFormat::Ascii) {
+            const char* next = skipLine(p, end);
+            double value = 0.0;
+            for (int k = 0; k < (int)element.properties.size(); k++) {
+                const PlyProperty& property = element.properties[k];
+                size_t count = 1;
+                if (property.isList) {
+                    if (!parseAsciiNumber(p, next, value)) {
+                        CV_Error(cv::Error::StsParseError, "Face PLY invalide: " + std::string(p, next));
+                    }
+                    count = listCount(value);
+                    if (k == indicesProperty) {
+                        polygons.push_back(static_cast<int>(count));
+                    }
+                }
+                for (size_t j = 0; j < count; j++) {
+                    if (!parseAsciiNumber(p, next, value)) {
+                        CV_Error(cv::Error::StsParseError, "Face PLY invalide: " + std::string(p, next));
+                    }
+                    if (k == indicesProperty) {
+                        polygons.push_back(static_cast<int>(value));
+                    }
+                }
+            }
+            p = next;
+        }
+        else {
+            for (int k = 0; k < (int)element.properties.size(); k++) {
+                const PlyProperty& property = element.properties[k];
+                size_t typeSize = plyTypeSize(property.type);
+                size_t count = 1;
+                if (property.isList) {
+                    size_t countSize = plyTypeSize(property.countType);
+                    if (static_cast<size_t>(end - p) < countSize) {
+                        CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: faces incompltes");
+                    }
+                    count = listCount(readBinaryValue(p, property.countType, swap));
+                    p += countSize;
+                    if (k == indicesProperty) {
+                        polygons.push_back(static_cast<int>(count));
+                    }
+                }
+                if (count > static_cast<size_t>(end - p) / typeSize) {
+                    CV_Error(cv::Error::StsParseError, "Fichier PLY tronqu: faces incompltes");
+                }
+                if (k == indicesProperty) {
+                    for (size_t j = 0; j < count; j++) {
+                        polygons.push_back(static_cast<int>(readBinaryValue(p + j * typeSize, property.type, swap)));
+                    }
+                }
+                p += count * typeSize;
+            }
+        }
+    }
+
+    // Vrifier les indices pour ne pas faire planter VTK plus loin
+    for (size_t i = 0; i < polygons.size(); i += polygons[i] + 1) {
+        for (int j = 1; j <= polygons[i]; j++) {
+            if (polygons[i + j] < 0 || static_cast<size_t>(polygons[i + j]) >= vertexCount_) {
+                CV_Error(cv::Error::StsOutOfRange, "Indice de sommet hors limites dans les faces PLY");
+            }
+        }
+    }
+    return polygons;
+}
+
+cv::viz::Mesh PlyFile::toVizMesh() const {
+    return ::toVizMesh(vertices_, readPolygons());
+}
+
+cv::viz::Mesh toVizMesh(const VertexView& vertices, const std::vector<int>& polygons) {
+    cv::viz::Mesh mesh;
+    if (vertices.isContiguous()) {
+        // Le widget ne fait que lire le nuage: on vite la copie
+        mesh.cloud = vertices.asMat();
+    }
+    else {
+        mesh.cloud.create(1, (int)vertices.size(), CV_32FC3);
+        cv::Point3f* dst = mesh.cloud.ptr<cv::Point3f>();
+        for (size_t i = 0; i < vertices.size(); i++) {
+            dst[i] = vertices[i];
+        }
+    }
+
+    if (!polygons.empty()) {
+        mesh.polygons = cv::Mat(polygons, true).reshape(1, 1);
+    }
+    return mesh;
+}
+
+void triangulatePolygons(const int* polygons, size_t polygonsSize, size_t vertexCount,
+    std::vector<cv::Vec3i>& triangles, std::vector<uint32_t>& faces, const uint32_t* sourceFaces) {
+    triangles.clear();
+    faces.clear();
+    size_t i = 0;
+    size_t faceCount = 0;
+    bool identity = true;    // triangle t issu de la face t, pour tout t
+    while (i < polygonsSize) {
+        int n = polygons[i];
+        if (n < 0 || i + 1 + (size_t)n > polygonsSize) {
+            CV_Error(cv::Error::StsBadArg, "Faces du maillage invalides");
+        }
+        const int* face = polygons + i + 1;
+        for (int k = 1; k + 1 < n; k++) {
+            cv::Vec3i t(face[0], face[k], face[k + 1]);
+            if ((size_t)t[0] < vertexCount && (size_t)t[1] < vertexCount && (size_t)t[2] < vertexCount) {
+                uint32_t source = sourceFaces ? sourceFaces[faceCount] : (uint32_t)faceCount;
+                identity = identity && source == triangles.size();
+                triangles.push_back(t);
+                faces.push_back(source);
+            }
+        }
+        i += 1 + (size_t)n;
+        faceCount++;
+    }
+
+    // Mmes nombres de faces et de triangles ne suffisent pas: une face de
+    // moins de trois sommets, sans triangle, dcale les suivantes
+    if (identity) {
+        faces.clear();
+        faces.shrink_to_fit();
+    }
+}
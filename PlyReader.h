@@ -0,0 +1,99 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/viz.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool isList = false;
+    PlyType countType = PlyType::UInt8;   // type du compteur pour les listes
+    size_t offset = 0;                    // position dans l'enregistrement binaire (si stride != 0)
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+    size_t stride = 0;                    // taille d'un enregistrement binaire, 0 si l'lment contient des listes
+
+    int findProperty(const std::string& propertyName) const;
+};
+
+struct PlyHeader {
+    PlyFormat format = PlyFormat::Ascii;
+    std::vector<PlyElement> elements;
+    size_t dataOffset = 0;                // dbut des donnes, juste aprs "end_header"
+
+    int findElement(const std::string& elementName) const;
+};
+
+// Analyse l'en-tte d'un fichier PLY. Lve une cv::Exception si l'en-tte est invalide.
+PlyHeader parsePlyHeader(const char* data, size_t size);
+
+size_t plyTypeSize(PlyType type);
+
+// Dcoupe en ventail des faces au format cv::viz::Mesh::polygons. Les
+// triangles ayant un indice hors de [0, vertexCount) sont ignors. faces reoit
+// la face d'origine de chaque triangle, et reste vide si le triangle i vient
+// de la face i pour tout i (maillage dj triangul, sans face ignore).
+// sourceFaces (facultatif) donne l'indice d'origine de chaque face de polygons
+// (faces renumrotes par la soudure, voir remapPolygons): faces reoit alors
+// ces indices.
+void triangulatePolygons(const int* polygons, size_t polygonsSize, size_t vertexCount,
+    std::vector<cv::Vec3i>& triangles, std::vector<uint32_t>& faces, const uint32_t* sourceFaces = nullptr);
+
+// Maillage pour l'affichage Viz. Le nuage partage les donnes de vertices
+// quand c'est possible (vertices doit alors rester valide); les faces sont
+// copies.
+cv::viz::Mesh toVizMesh(const VertexView& vertices, const std::vector<int>& polygons);
+
+// Lecteur PLY minimal pour le pipeline de pose: seuls les sommets (x, y, z) et
+// les faces sont lus. Le fichier est projet en mmoire; pour un PLY binaire
+// little-endian avec des coordonnes float, les sommets sont exposs
+// directement sur le fichier, sans aucune copie.
+class PlyFile {
+public:
+    PlyFile() = default;
+
+    static PlyFile load(const std::string& path);
+
+    const PlyHeader& header() const { return header_; }
+    size_t vertexCount() const { return vertexCount_; }
+
+    // Vue sur les sommets, valide tant que le PlyFile existe.
+    VertexView vertices() const { return vertices_; }
+
+    bool hasFaces() const { return faceElement_ >= 0; }
+    size_t faceCount() const { return hasFaces() ? header_.elements[faceElement_].count : 0; }
+
+    // Faces au format cv::viz::Mesh::polygons: n, i0, ..., i(n-1), n, ...
+    std::vector<int> readPolygons() const;
+
+    // Maillage pour l'affichage Viz. Le nuage partage les donnes du fichier
+    // quand c'est possible.
+    cv::viz::Mesh toVizMesh() const;
+
+private:
+    const char* elementData(int elementIndex) const;
+    void readVertices();
+
+    MappedFile file_;
+    PlyHeader header_;
+    int vertexElement_ = -1;
+    int faceElement_ = -1;
+    size_t vertexCount_ = 0;
+    std::vector<size_t> elementOffsets_;      // PLY binaire: dbut de chaque lment
+    std::vector<cv::Point3f> convertedVertices_;
+    VertexView vertices_;
+};
@@ -0,0 +1,188 @@
+#include "PointOctree.h"
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+
+namespace {
+const int maxDepth = 21;
+const float focusFalloff = 2.f;    // rduction de priorit vers les bords de la fentre
+}
+
+bool LodCamera::operator==(const LodCamera& other) const {
+    return std::memcmp(r, other.r, sizeof(r)) == 0 && position == other.position && fx == other.fx &&
+        fy == other.fy && cx == other.cx && cy == other.cy && width == other.width && height == other.height;
+}
+
+PointOctree PointOctree::build(const VertexView& vertices, uint32_t pointsPerNode) {
+    CV_Assert(vertices.size() < std::numeric_limits<uint32_t>::max() && pointsPerNode > 0);
+    PointOctree octree;
+    octree.vertices_ = vertices;
+    octree.pointsPerNode_ = pointsPerNode;
+    if (vertices.size() == 0) {
+        return octree;
+    }
+
+    octree.order_.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        octree.order_[i] = (uint32_t)i;
+    }
+
+    // Cube englobant
+    BoundingBox bounds = computeBoundingBox(vertices);
+    cv::Point3f extent = bounds.size();
+    Node root;
+    root.center[0] = (bounds.min.x + bounds.max.x) * 0.5f;
+    root.center[1] = (bounds.min.y + bounds.max.y) * 0.5f;
+    root.center[2] = (bounds.min.z + bounds.max.z) * 0.5f;
+    root.halfSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 0.5f;
+    root.first = 0;
+    root.count = (uint32_t)vertices.size();
+    root.firstChild = 0;
+    root.childCount = 0;
+    octree.nodes_.push_back(root);
+
+    // Dcoupage en profondeur avec une pile explicite: tri par dnombrement
+    // des sommets du noeud selon leur octant
+    std::vector<uint32_t> scratch(vertices.size());
+    std::vector<unsigned char> octants(vertices.size());
+    std::vector<std::pair<uint32_t, int>> stack;
+    stack.push_back({ 0, 0 });
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        Node node = octree.nodes_[nodeIndex];
+        if (node.count <= pointsPerNode || depth >= maxDepth) {
+            continue;
+        }
+
+        uint32_t* range = octree.order_.data() + node.first;
+        uint32_t counts[8] = {};
+        for (uint32_t i = 0; i < node.count; i++) {
+            cv::Point3f p = vertices[range[i]];
+            unsigned char octant = (unsigned char)((p.x >= node.center[0] ? 1 : 0) | (p.y >= node.center[1] ? 2 : 0) |
+                (p.z >= node.center[2] ? 4 : 0));
+            octants[i] = octant;
+            counts[octant]++;
+        }
+        uint32_t offsets[8];
+        uint32_t offset = 0;
+        for (int o = 0; o < 8; o++) {
+            offsets[o] = offset;
+            offset += counts[o];
+        }
+        for (uint32_t i = 0; i < node.count; i++) {
+            scratch[offsets[octants[i]]++] = range[i];
+        }
+        std::copy(scratch.begin(), scratch.begin() + node.count, range);
+
+        // Enfants non vides, ajouts  la suite
+        uint32_t firstChild = (uint32_t)octree.nodes_.size();
+        uint32_t childCount = 0;
+        offset = node.first;
+        float quarter = node.halfSize * 0.5f;
+        for (int o = 0; o < 8; o++) {
+            if (counts[o] == 0) {
+                continue;
+            }
+            Node child;
+            child.center[0] = node.center[0] + ((o & 1) ? quarter : -quarter);
+            child.center[1] = node.center[1] + ((o & 2) ? quarter : -quarter);
+            child.center[2] = node.center[2] + ((o & 4) ? quarter : -quarter);
+            child.halfSize = quarter;
+            child.first = offset;
+            child.count = counts[o];
+            child.firstChild = 0;
+            child.childCount = 0;
+            offset += counts[o];
+            octree.nodes_.push_back(child);
+            stack.push_back({ firstChild + childCount, depth + 1 });
+            childCount++;
+        }
+        octree.nodes_[nodeIndex].firstChild = firstChild;
+        octree.nodes_[nodeIndex].childCount = childCount;
+    }
+    return octree;
+}
+
+void PointOctree::selectLod(const LodCamera& camera, size_t pointBudget, float pointSpacing,
+    std::vector<uint32_t>& cut) const {
+    cut.clear();
+    if (nodes_.empty()) {
+        return;
+    }
+
+    // cart apparent (pixels) entre les points de l'chantillon d'un noeud,
+    // pondr par la proximit du centre de la fentre; nul hors de la vue
+    const float* r = camera.r;
+    const float focal = std::max(camera.fx, camera.fy);
+    const float halfDiagonal = 0.5f * std::sqrt((float)camera.width * camera.width + (float)camera.height * camera.height);
+    auto priority = [&](const Node& node) {
+        float dx = node.center[0] - camera.position.x;
+        float dy = node.center[1] - camera.position.y;
+        float dz = node.center[2] - camera.position.z;
+        float x = r[0] * dx + r[1] * dy + r[2] * dz;
+        float y = r[3] * dx + r[4] * dy + r[5] * dz;
+        float z = r[6] * dx + r[7] * dy + r[8] * dz;
+        float radius = node.halfSize * 1.7320508f;
+        if (z + radius <= 0.f) {
+            return 0.f;
+        }
+        // Noeud contenant la camra ou tout proche:  raffiner en priorit
+        float depth = std::max(z - radius, radius * 0.05f);
+        float projectedRadius = focal * radius / depth;
+        float distanceToCenter = 0.f;
+        if (z > 0.f) {
+            float u = camera.fx * x / z + camera.cx - camera.width * 0.5f;
+            float v = camera.fy * y / z + camera.cy - camera.height * 0.5f;
+            if (std::abs(u) > camera.width * 0.5f + projectedRadius || std::abs(v) > camera.height * 0.5f + projectedRadius) {
+                return 0.f;
+            }
+            distanceToCenter = std::max(0.f, std::sqrt(u * u + v * v) - projectedRadius) / std::max(halfDiagonal, 1.f);
+        }
+        float spacing = focal * 2.f * node.halfSize / (depth * std::sqrt((float)sampleCount(node)));
+        return spacing / (1.f + focusFalloff * distanceToCenter * distanceToCenter);
+    };
+
+    typedef std::pair<float, uint32_t> Entry;
+    std::priority_queue<Entry> queue;
+    size_t points = sampleCount(nodes_[0]);
+    queue.push(Entry(priority(nodes_[0]), 0));
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+        const Node& node = nodes_[entry.second];
+        if (node.childCount == 0 || entry.first <= pointSpacing) {
+            cut.push_back(entry.second);
+            continue;
+        }
+        size_t childPoints = 0;
+        for (uint32_t c = 0; c < node.childCount; c++) {
+            childPoints += sampleCount(nodes_[node.firstChild + c]);
+        }
+        if (points - sampleCount(node) + childPoints > pointBudget) {
+            cut.push_back(entry.second);
+            continue;
+        }
+        points += childPoints - sampleCount(node);
+        for (uint32_t c = 0; c < node.childCount; c++) {
+            queue.push(Entry(priority(nodes_[node.firstChild + c]), node.firstChild + c));
+        }
+    }
+    std::sort(cut.begin(), cut.end());
+}
+
+void PointOctree::gatherPoints(const std::vector<uint32_t>& cut, std::vector<cv::Point3f>& points) const {
+    points.clear();
+    for (uint32_t index : cut) {
+        const Node& node = nodes_[index];
+        uint32_t samples = sampleCount(node);
+        for (uint32_t k = 0; k < samples; k++) {
+            points.push_back(vertices_[order_[node.first + (uint32_t)((uint64_t)k * node.count / samples)]]);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Camra de la fentre 3D, pour le choix du niveau de dtail
+struct LodCamera {
+    float r[9] = { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f };  // monde -> camra, par lignes (z: axe de vise)
+    cv::Point3f position;
+    float fx = 1.f, fy = 1.f, cx = 0.f, cy = 0.f;
+    int width = 0;
+    int height = 0;
+
+    bool operator==(const LodCamera& other) const;
+    bool operator!=(const LodCamera& other) const { return !(*this == other); }
+};
+
+// Octree sur les sommets, pour afficher un nuage  niveau de dtail variable:
+// fin prs de l'endroit regard, grossier ailleurs, avec un nombre de points
+// born quelle que soit la taille du maillage.
+// Les indices de sommets sont permuts pour que ceux d'un noeud soient
+// contigus; l'chantillon d'un noeud est pris  pas rgulier dans sa plage,
+// donc rparti entre ses enfants sans stockage supplmentaire.
+class PointOctree {
+public:
+    PointOctree() = default;
+
+    // vertices doit rester valide
+    static PointOctree build(const VertexView& vertices, uint32_t pointsPerNode = 256);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t nodeCount() const { return nodes_.size(); }
+
+    // Coupe de l'arbre pour cette vue (indices de noeuds, croissants): les
+    // noeuds visibles sont raffins, du plus grand cart apparent entre points
+    // (et du plus proche du centre de la fentre) au plus petit, jusqu' un
+    // cart de pointSpacing pixels ou pointBudget points.
+    void selectLod(const LodCamera& camera, size_t pointBudget, float pointSpacing, std::vector<uint32_t>& cut) const;
+
+    // Points chantillonns des noeuds d'une coupe
+    void gatherPoints(const std::vector<uint32_t>& cut, std::vector<cv::Point3f>& points) const;
+
+private:
+    struct Node {
+        float center[3];
+        float halfSize;
+        uint32_t first;         // plage dans order_
+        uint32_t count;
+        uint32_t firstChild;    // enfants non vides, contigus
+        uint32_t childCount;
+    };
+
+    uint32_t sampleCount(const Node& node) const { return node.count < pointsPerNode_ ? node.count : pointsPerNode_; }
+
+    VertexView vertices_;
+    std::vector<uint32_t> order_;
+    std::vector<Node> nodes_;
+    uint32_t pointsPerNode_ = 256;
+};
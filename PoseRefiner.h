@@ -0,0 +1,307 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Raffinement de pose par Levenberg-Marquardt, sans allocation: jacobiennes
+// analytiques, quations normales 6x6 sur la pile et espace de travail fourni
+// par l'appelant (rutilis d'un appel  l'autre, il ne grandit qu'au premier
+// appel avec plus de points). Mme entres que cv::solvePnP (points 3D, points
+// 2D, K, distorsion, pose initiale rvec/tvec).
+// La distorsion est retire des points 2D une fois pour toutes; l'erreur
+// minimise est l'cart en pixels entre points projets et points redresss.
+
+struct PoseRefinerParams {
+    int maxIterations = 20;
+    double minStep = 1e-10;         // arrt quand l'incrment de pose devient ngligeable
+    double minRelativeDecrease = 1e-12;
+};
+
+struct PoseRefinerResult {
+    int iterations = 0;
+    double initialRms = 0.0;        // pixels
+    double finalRms = 0.0;
+    bool converged = false;
+};
+
+template <typename T>
+struct PoseRefinerWorkspace {
+    std::vector<cv::Point_<T>> normalized;
+};
+
+namespace poserefiner {
+
+template <typename T>
+cv::Matx<T, 3, 3> rotationFromVector(const cv::Vec<T, 3>& r) {
+    T theta = std::sqrt(r.dot(r));
+    if (theta < T(1e-12)) {
+        return cv::Matx<T, 3, 3>(1, -r[2], r[1], r[2], 1, -r[0], -r[1], r[0], 1);
+    }
+    T x = r[0] / theta, y = r[1] / theta, z = r[2] / theta;
+    T c = std::cos(theta), s = std::sin(theta), v = 1 - c;
+    return cv::Matx<T, 3, 3>(
+        c + x * x * v, x * y * v - z * s, x * z * v + y * s,
+        y * x * v + z * s, c + y * y * v, y * z * v - x * s,
+        z * x * v - y * s, z * y * v + x * s, c + z * z * v);
+}
+
+template <typename T>
+cv::Vec<T, 3> vectorFromRotation(const cv::Matx<T, 3, 3>& R) {
+    T cosTheta = (R(0, 0) + R(1, 1) + R(2, 2) - 1) / 2;
+    cosTheta = cosTheta > 1 ? 1 : (cosTheta < -1 ? -1 : cosTheta);
+    T theta = std::acos(cosTheta);
+    cv::Vec<T, 3> axis(R(2, 1) - R(1, 2), R(0, 2) - R(2, 0), R(1, 0) - R(0, 1));
+    if (theta < T(1e-6)) {
+        return axis * T(0.5);
+    }
+    if (theta > T(CV_PI) - T(1e-4)) {
+        // Prs de pi, sin(theta) ne donne plus l'axe: il est tir de la
+        // diagonale (R(i, i) = cos + (1 - cos) u(i)^2)
+        T xx = std::sqrt(std::max<T>(0, (R(0, 0) - cosTheta) / (1 - cosTheta)));
+        T yy = std::sqrt(std::max<T>(0, (R(1, 1) - cosTheta) / (1 - cosTheta)));
+        T zz = std::sqrt(std::max<T>(0, (R(2, 2) - cosTheta) / (1 - cosTheta)));
+        if (xx >= yy && xx >= zz) {
+            yy = std::copysign(yy, R(0, 1) + R(1, 0));
+            zz = std::copysign(zz, R(0, 2) + R(2, 0));
+        }
+        else if (yy >= zz) {
+            xx = std::copysign(xx, R(0, 1) + R(1, 0));
+            zz = std::copysign(zz, R(1, 2) + R(2, 1));
+        }
+        else {
+            xx = std::copysign(xx, R(0, 2) + R(2, 0));
+            yy = std::copysign(yy, R(1, 2) + R(2, 1));
+        }
+        cv::Vec<T, 3> u(xx, yy, zz);
+        if (u.dot(axis) < 0) {
+            u = -u;
+        }
+        return u * (theta / std::sqrt(u.dot(u)));
+    }
+    return axis * (theta / (2 * std::sin(theta)));
+}
+
+// Rsout A x = b (A 6x6 symtrique dfinie positive) par Cholesky en place.
+// Retourne false si A n'est pas dfinie positive.
+template <typename T>
+bool solveCholesky6(cv::Matx<T, 6, 6>& A, cv::Vec<T, 6>& b) {
+    for (int j = 0; j < 6; j++) {
+        T d = A(j, j);
+        for (int k = 0; k < j; k++) {
+            d -= A(j, k) * A(j, k);
+        }
+        if (d <= 0) {
+            return false;
+        }
+        A(j, j) = std::sqrt(d);
+        for (int i = j + 1; i < 6; i++) {
+            T s = A(i, j);
+            for (int k = 0; k < j; k++) {
+                s -= A(i, k) * A(j, k);
+            }
+            A(i, j) = s / A(j, j);
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        for (int k = 0; k < i; k++) {
+            b[i] -= A(i, k) * b[k];
+        }
+        b[i] /= A(i, i);
+    }
+    for (int i = 5; i >= 0; i--) {
+        for (int k = i + 1; k < 6; k++) {
+            b[i] -= A(k, i) * b[k];
+        }
+        b[i] /= A(i, i);
+    }
+    return true;
+}
+
+// Cot (somme des carrs en pixels) et, si JtJ est fourni, quations normales
+template <typename T, typename S, typename N>
+T accumulate(const cv::Point3_<S>* objectPoints, const cv::Point_<N>* normalized, const unsigned char* mask,
+    size_t count, T fx, T fy, const cv::Matx<T, 3, 3>& R, const cv::Vec<T, 3>& t,
+    cv::Matx<T, 6, 6>* JtJ, cv::Vec<T, 6>* Jtr, size_t& used) {
+    T cost = 0;
+    used = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (mask && !mask[i]) {
+            continue;
+        }
+        cv::Vec<T, 3> X((T)objectPoints[i].x, (T)objectPoints[i].y, (T)objectPoints[i].z);
+        cv::Vec<T, 3> Xc = R * X + t;
+        if (Xc[2] <= T(1e-12)) {
+            continue;
+        }
+        T iz = 1 / Xc[2];
+        T u = Xc[0] * iz, v = Xc[1] * iz;
+        T ru = fx * (u - (T)normalized[i].x);
+        T rv = fy * (v - (T)normalized[i].y);
+        cost += ru * ru + rv * rv;
+        used++;
+        if (!JtJ) {
+            continue;
+        }
+
+        // Drives par rapport  (rotation, translation), perturbation  gauche
+        // de la pose: Xc' = exp(w) Xc + dt
+        T Ju[6] = { -fx * u * v, fx * (1 + u * u), -fx * v, fx * iz, 0, -fx * u * iz };
+        T Jv[6] = { -fy * (1 + v * v), fy * u * v, fy * u, 0, fy * iz, -fy * v * iz };
+        for (int a = 0; a < 6; a++) {
+            (*Jtr)[a] += Ju[a] * ru + Jv[a] * rv;
+            for (int b = a; b < 6; b++) {
+                (*JtJ)(a, b) += Ju[a] * Ju[b] + Jv[a] * Jv[b];
+            }
+        }
+    }
+    if (JtJ) {
+        for (int a = 0; a < 6; a++) {
+            for (int b = 0; b < a; b++) {
+                (*JtJ)(a, b) = (*JtJ)(b, a);
+            }
+        }
+    }
+    return cost;
+}
+
+} // namespace poserefiner
+
+// Raffinement sur des points 2D dj redresss (coordonnes normalises).
+// mask (facultatif): seuls les points non nuls sont utiliss.
+template <typename T, typename S, typename N>
+PoseRefinerResult refinePoseNormalized(const cv::Point3_<S>* objectPoints, const cv::Point_<N>* normalized,
+    const unsigned char* mask, size_t count, T fx, T fy, cv::Vec<T, 3>& rvec, cv::Vec<T, 3>& tvec,
+    const PoseRefinerParams& params = PoseRefinerParams()) {
+    using namespace poserefiner;
+    PoseRefinerResult result;
+    cv::Matx<T, 3, 3> R = rotationFromVector(rvec);
+    cv::Vec<T, 3> t = tvec;
+    size_t used = 0;
+    T cost = accumulate<T, S, N>(objectPoints, normalized, mask, count, fx, fy, R, t, nullptr, nullptr, used);
+    result.initialRms = used > 0 ? std::sqrt(cost / used) : 0.0;
+    if (used < 3) {
+        result.finalRms = result.initialRms;
+        return result;
+    }
+
+    T lambda = T(1e-3);
+    for (result.iterations = 0; result.iterations < params.maxIterations; result.iterations++) {
+        cv::Matx<T, 6, 6> JtJ = cv::Matx<T, 6, 6>::zeros();
+        cv::Vec<T, 6> Jtr = cv::Vec<T, 6>::zeros();
+        accumulate<T, S, N>(objectPoints, normalized, mask, count, fx, fy, R, t, &JtJ, &Jtr, used);
+
+        // Essais avec un amortissement croissant jusqu' faire baisser le cot
+        bool improved = false;
+        for (int attempt = 0; attempt < 10 && !improved; attempt++) {
+            cv::Matx<T, 6, 6> A = JtJ;
+            for (int a = 0; a < 6; a++) {
+                A(a, a) += lambda * (JtJ(a, a) + T(1e-12));
+            }
+            cv::Vec<T, 6> step = -Jtr;
+            if (!solveCholesky6(A, step)) {
+                lambda *= 10;
+                continue;
+            }
+
+            cv::Matx<T, 3, 3> dR = rotationFromVector(cv::Vec<T, 3>(step[0], step[1], step[2]));
+            cv::Matx<T, 3, 3> newR = dR * R;
+            cv::Vec<T, 3> newT = dR * t + cv::Vec<T, 3>(step[3], step[4], step[5]);
+            size_t newUsed = 0;
+            T newCost = accumulate<T, S, N>(objectPoints, normalized, mask, count, fx, fy, newR, newT, nullptr, nullptr, newUsed);
+            if (newCost < cost && newUsed == used) {
+                T decrease = (cost - newCost) / cost;
+                R = newR;
+                t = newT;
+                cost = newCost;
+                lambda = std::max<T>(lambda / 10, T(1e-9));
+                improved = true;
+                if (std::sqrt(step.dot(step)) < params.minStep || decrease < params.minRelativeDecrease) {
+                    result.converged = true;
+                }
+            }
+            else {
+                lambda *= 10;
+            }
+        }
+        if (!improved || result.converged) {
+            result.converged = true;
+            break;
+        }
+    }
+
+    rvec = vectorFromRotation(R);
+    tvec = t;
+    result.finalRms = std::sqrt(cost / used);
+    return result;
+}
+
+// Retire la distorsion des points 2D (mthode itrative d'OpenCV, 4, 5 ou 8
+// coefficients) vers l'espace de travail. Les modles  12 ou 14 coefficients
+// (prisme mince, capteur inclin) ne sont pas grs.
+template <typename T, typename S>
+void undistortToWorkspace(const cv::Point_<S>* imagePoints, size_t count, const cv::Matx<T, 3, 3>& K,
+    const T* distCoeffs, int distCount, PoseRefinerWorkspace<T>& workspace) {
+    CV_Assert(distCount >= 0 && distCount <= 8);
+    workspace.normalized.resize(count);
+    T k[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < distCount; i++) {
+        k[i] = distCoeffs[i];
+    }
+    bool distorted = false;
+    for (int i = 0; i < 8; i++) {
+        distorted = distorted || k[i] != 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        T x0 = ((T)imagePoints[i].x - K(0, 2)) / K(0, 0);
+        T y0 = ((T)imagePoints[i].y - K(1, 2)) / K(1, 1);
+        T x = x0, y = y0;
+        for (int iteration = 0; distorted && iteration < 5; iteration++) {
+            T r2 = x * x + y * y;
+            T icdist = (1 + ((k[7] * r2 + k[6]) * r2 + k[5]) * r2) / (1 + ((k[4] * r2 + k[1]) * r2 + k[0]) * r2);
+            T dx = 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x);
+            T dy = k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y;
+            x = (x0 - dx) * icdist;
+            y = (y0 - dy) * icdist;
+        }
+        workspace.normalized[i] = cv::Point_<T>(x, y);
+    }
+}
+
+// Raffinement avec les mmes entres que l'tape 9 (points, K, distorsion)
+template <typename T, typename S>
+PoseRefinerResult refinePose(const cv::Point3_<S>* objectPoints, const cv::Point_<S>* imagePoints, size_t count,
+    const cv::Matx<T, 3, 3>& K, const T* distCoeffs, int distCount, cv::Vec<T, 3>& rvec, cv::Vec<T, 3>& tvec,
+    PoseRefinerWorkspace<T>& workspace, const unsigned char* mask = nullptr,
+    const PoseRefinerParams& params = PoseRefinerParams()) {
+    undistortToWorkspace(imagePoints, count, K, distCoeffs, distCount, workspace);
+    return refinePoseNormalized<T, S, T>(objectPoints, workspace.normalized.data(), mask, count, K(0, 0), K(1, 1),
+        rvec, tvec, params);
+}
+
+// Variante sur les types de l'tape 9. cameraMatrix et distCoeffs en CV_64F,
+// rvec et tvec 3x1 CV_64F (modifis en place).
+inline PoseRefinerResult refinePose(const std::vector<cv::Point3f>& objectPoints, const std::vector<cv::Point2f>& imagePoints,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, cv::Mat& rvec, cv::Mat& tvec,
+    PoseRefinerWorkspace<double>& workspace, const unsigned char* mask = nullptr,
+    const PoseRefinerParams& params = PoseRefinerParams()) {
+    CV_Assert(objectPoints.size() == imagePoints.size());
+    CV_Assert(cameraMatrix.type() == CV_64F && (distCoeffs.empty() || distCoeffs.type() == CV_64F));
+    CV_Assert(rvec.type() == CV_64F && rvec.total() == 3 && tvec.type() == CV_64F && tvec.total() == 3);
+    cv::Matx33d K;
+    for (int i = 0; i < 9; i++) {
+        K.val[i] = cameraMatrix.at<double>(i / 3, i % 3);
+    }
+    double* r = rvec.ptr<double>();
+    double* t = tvec.ptr<double>();
+    cv::Vec3d rv(r[0], r[1], r[2]), tv(t[0], t[1], t[2]);
+    PoseRefinerResult result = refinePose<double, float>(objectPoints.data(), imagePoints.data(), objectPoints.size(), K,
+        distCoeffs.empty() ? nullptr : distCoeffs.ptr<double>(), (int)distCoeffs.total(), rv, tv, workspace, mask, params);
+    for (int i = 0; i < 3; i++) {
+        r[i] = rv[i];
+        t[i] = tv[i];
+    }
+    return result;
+}
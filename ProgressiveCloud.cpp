@@ -0,0 +1,135 @@
+#include "ProgressiveCloud.h"
+
+#include <algorithm>
+
+namespace {
+// Blocs prts en attente au maximum: le producteur ne recopie pas tout le
+// maillage d'avance si l'affichage est plus lent que la lecture
+const size_t maxPendingChunks = 4;
+}
+
+ProgressiveCloud::ProgressiveCloud(const VertexView& vertices, const SpatialGrid* grid, size_t chunkSize)
+    : vertices_(vertices), grid_(grid), chunkSize_(std::max<size_t>(1, chunkSize)),
+      stopRequested_(false) {
+    thread_ = std::thread(&ProgressiveCloud::run, this);
+}
+
+ProgressiveCloud::~ProgressiveCloud() {
+    stop();
+}
+
+void ProgressiveCloud::stop() {
+    {
+        // Sous le verrou: le producteur ne peut pas manquer le rveil entre
+        // le test de son prdicat et sa mise en attente
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    chunkTaken_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool ProgressiveCloud::popChunk(std::vector<cv::Point3f>& chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (chunks_.empty()) {
+            return false;
+        }
+        chunk.swap(chunks_.front());
+        chunks_.pop_front();
+    }
+    chunkTaken_.notify_one();
+    return true;
+}
+
+void ProgressiveCloud::run() {
+    if (grid_ != nullptr && !grid_->empty()) {
+        runGrid();
+    }
+    else {
+        runStrided();
+    }
+}
+
+void ProgressiveCloud::emit(std::vector<cv::Point3f>& chunk, bool force) {
+    if (chunk.empty() || (!force && chunk.size() < chunkSize_)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    chunkTaken_.wait(lock, [this]() { return chunks_.size() < maxPendingChunks || stopRequested_; });
+    chunks_.push_back(std::move(chunk));
+    chunk.clear();
+    chunk.reserve(chunkSize_);
+}
+
+void ProgressiveCloud::runGrid() {
+    const uint32_t* cellStart = grid_->cellStart();
+    const uint32_t* indices = grid_->indices();
+
+    std::vector<uint32_t> activeCells;
+    for (size_t c = 0; c < grid_->cellCount(); c++) {
+        if (cellStart[c + 1] > cellStart[c]) {
+            activeCells.push_back((uint32_t)c);
+        }
+    }
+
+    // Niveau n: 2^n sommets de plus par cellule encore non puise
+    std::vector<cv::Point3f> chunk;
+    chunk.reserve(chunkSize_);
+    uint32_t taken = 0;
+    uint32_t quota = 1;
+    while (!activeCells.empty() && !stopRequested_) {
+        for (uint32_t cell : activeCells) {
+            uint32_t begin = cellStart[cell] + taken;
+            uint32_t end = std::min(cellStart[cell + 1], begin + quota);
+            for (uint32_t k = begin; k < end; k++) {
+                chunk.push_back(vertices_[indices[k]]);
+                if (chunk.size() >= chunkSize_) {
+                    emit(chunk, false);
+                    if (stopRequested_) {
+                        return;
+                    }
+                }
+            }
+        }
+        taken += quota;
+        quota *= 2;
+        activeCells.erase(std::remove_if(activeCells.begin(), activeCells.end(),
+            [&](uint32_t cell) { return cellStart[cell + 1] - cellStart[cell] <= taken; }), activeCells.end());
+    }
+    emit(chunk, true);
+}
+
+void ProgressiveCloud::runStrided() {
+    // Premier niveau: au plus un bloc, puis les sommets intercals, pas divis par deux
+    size_t stride = 1;
+    while (vertices_.size() / stride > chunkSize_) {
+        stride *= 2;
+    }
+
+    std::vector<cv::Point3f> chunk;
+    chunk.reserve(chunkSize_);
+    size_t first = 0;
+    size_t step = stride;
+    for (;;) {
+        for (size_t i = first; i < vertices_.size(); i += step) {
+            chunk.push_back(vertices_[i]);
+            if (chunk.size() >= chunkSize_) {
+                emit(chunk, false);
+                if (stopRequested_) {
+                    return;
+                }
+            }
+        }
+        if (stride == 1) {
+            break;
+        }
+        // Niveau suivant: indices impairs multiples de stride/2
+        stride /= 2;
+        first = stride;
+        step = stride * 2;
+    }
+    emit(chunk, true);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "SpatialGrid.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Flux de sommets du plus grossier au plus fin, produit sur un thread de fond
+// pour remplir l'affichage pendant que le reste du maillage se charge.
+// Avec une grille spatiale (cache), chaque niveau prend 1, 2, 4... sommets de
+// plus dans chaque cellule: l'aperu couvre tout le modle ds le premier bloc.
+// Sans grille, les sommets sont pris dans l'ordre du fichier avec un pas divis
+// par deux  chaque niveau.
+class ProgressiveCloud {
+public:
+    ProgressiveCloud(const VertexView& vertices, const SpatialGrid* grid, size_t chunkSize = 1 << 19);
+    ~ProgressiveCloud();
+
+    ProgressiveCloud(const ProgressiveCloud&) = delete;
+    ProgressiveCloud& operator=(const ProgressiveCloud&) = delete;
+
+    // Rcupre un bloc prt sans attendre. Retourne false s'il n'y en a pas.
+    bool popChunk(std::vector<cv::Point3f>& chunk);
+
+    void stop();
+
+private:
+    void run();
+    void emit(std::vector<cv::Point3f>& chunk, bool force);
+    void runGrid();
+    void runStrided();
+
+    VertexView vertices_;
+    const SpatialGrid* grid_;
+    size_t chunkSize_;
+    std::mutex mutex_;
+    std::condition_variable chunkTaken_;
+    std::deque<std::vector<cv::Point3f>> chunks_;
+    std::atomic<bool> stopRequested_;
+    std::thread thread_;
+};
@@ -0,0 +1,187 @@
+#include "Projection.h"
+#include "Parallel.h"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+const size_t projectionBlockSize = 1 << 16;
+const size_t accumulationBlockSize = 1024;      // sommets spars sur la pile  la fois
+const size_t parallelBlockSize = 1 << 16;
+const size_t minVerticesPerThread = 1 << 18;
+const size_t maxPartialCountBytes = size_t(256) << 20;
+
+uint32_t* prepareCounts(const ProjectionParams& params, cv::Mat& counts) {
+    if (counts.type() != CV_32S || counts.rows != params.height || counts.cols != params.width) {
+        counts = cv::Mat::zeros(params.height, params.width, CV_32S);
+    }
+    CV_Assert(counts.isContinuous());
+    return reinterpret_cast<uint32_t*>(counts.ptr<int>());
+}
+
+// Rpartit les sommets [0, count) par blocs entre les threads. Chaque thread
+// cumule dans sa propre image de comptes (le premier directement dans counts),
+// fusionnes ligne par ligne  la fin: aucune criture partage pendant la
+// projection. Le nombre de threads est born par la mmoire des images.
+// accumulateBlock(first, n, counts) projette les sommets [first, first + n).
+template <typename F>
+void accumulateParallel(size_t count, const ProjectionParams& params, cv::Mat& counts, F accumulateBlock) {
+    uint32_t* out = prepareCounts(params, counts);
+    size_t pixels = (size_t)params.width * params.height;
+    size_t threads = std::min<size_t>((size_t)parallelThreadCount(), count / minVerticesPerThread + 1);
+    threads = std::min(threads, maxPartialCountBytes / std::max<size_t>(1, pixels * sizeof(uint32_t)) + 1);
+    if (threads <= 1) {
+        accumulateBlock(0, count, out);
+        return;
+    }
+
+    std::vector<std::vector<uint32_t>> partial(threads - 1);
+    long long blocks = (long long)((count + parallelBlockSize - 1) / parallelBlockSize);
+#pragma omp parallel num_threads((int)threads)
+    {
+        int thread = parallelThreadIndex();
+        uint32_t* local = out;
+        if (thread > 0) {
+            partial[thread - 1].assign(pixels, 0);
+            local = partial[thread - 1].data();
+        }
+#pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; b++) {
+            size_t first = (size_t)b * parallelBlockSize;
+            accumulateBlock(first, std::min(parallelBlockSize, count - first), local);
+        }
+    }
+
+#pragma omp parallel for
+    for (long long row = 0; row < (long long)params.height; row++) {
+        uint32_t* dst = out + (size_t)row * params.width;
+        for (const std::vector<uint32_t>& image : partial) {
+            if (image.empty()) {
+                continue;
+            }
+            const uint32_t* src = image.data() + (size_t)row * params.width;
+            for (int x = 0; x < params.width; x++) {
+                dst[x] += src[x];
+            }
+        }
+    }
+}
+}
+
+void projectVertices(const VertexView& vertices, const cv::Mat& rvec, const cv::Mat& tvec,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<cv::Point2f>& imagePoints) {
+    imagePoints.clear();
+    if (vertices.empty()) {
+        return;
+    }
+
+    if (vertices.isContiguous()) {
+        cv::projectPoints(vertices.asMat(), rvec, tvec, cameraMatrix, distCoeffs, imagePoints);
+        return;
+    }
+
+    imagePoints.reserve(vertices.size());
+    std::vector<cv::Point3f> block;
+    std::vector<cv::Point2f> projectedBlock;
+    for (size_t first = 0; first < vertices.size(); first += projectionBlockSize) {
+        vertices.subview(first, projectionBlockSize).copyTo(block);
+        cv::projectPoints(block, rvec, tvec, cameraMatrix, distCoeffs, projectedBlock);
+        imagePoints.insert(imagePoints.end(), projectedBlock.begin(), projectedBlock.end());
+    }
+}
+
+void projectVertices(const QuantizedVertexView& vertices, const cv::Mat& rvec, const cv::Mat& tvec,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<cv::Point2f>& imagePoints) {
+    imagePoints.clear();
+    imagePoints.reserve(vertices.size());
+    std::vector<cv::Point3f> block;
+    std::vector<cv::Point2f> projectedBlock;
+    for (size_t first = 0; first < vertices.size(); first += projectionBlockSize) {
+        QuantizedVertexView part = vertices.subview(first, projectionBlockSize);
+        block.resize(part.size());
+        part.dequantize(block.data());
+        cv::projectPoints(block, rvec, tvec, cameraMatrix, distCoeffs, projectedBlock);
+        imagePoints.insert(imagePoints.end(), projectedBlock.begin(), projectedBlock.end());
+    }
+}
+
+void accumulateVertices(const VertexView& vertices, const ProjectionParams& params, cv::Mat& counts) {
+    const unsigned char* x = vertices.componentData(0);
+    const unsigned char* y = vertices.componentData(1);
+    const unsigned char* z = vertices.componentData(2);
+    bool aligned = ((uintptr_t)x | (uintptr_t)y | (uintptr_t)z) % alignof(float) == 0;
+    if (vertices.isComponentArrays() && aligned) {
+        const float* fx = reinterpret_cast<const float*>(x);
+        const float* fy = reinterpret_cast<const float*>(y);
+        const float* fz = reinterpret_cast<const float*>(z);
+        accumulateParallel(vertices.size(), params, counts, [&](size_t first, size_t n, uint32_t* out) {
+            accumulateProjection(fx + first, fy + first, fz + first, n, params, out);
+        });
+        return;
+    }
+
+    // Sommets entrelacs: spars par petits blocs sur la pile
+    accumulateParallel(vertices.size(), params, counts, [&](size_t first, size_t n, uint32_t* out) {
+        float bx[accumulationBlockSize], by[accumulationBlockSize], bz[accumulationBlockSize];
+        for (size_t done = 0; done < n; done += accumulationBlockSize) {
+            VertexView block = vertices.subview(first + done, std::min(accumulationBlockSize, n - done));
+            for (size_t i = 0; i < block.size(); i++) {
+                cv::Point3f p = block[i];
+                bx[i] = p.x;
+                by[i] = p.y;
+                bz[i] = p.z;
+            }
+            accumulateProjection(bx, by, bz, block.size(), params, out);
+        }
+    });
+}
+
+void accumulateVertices(const QuantizedVertexView& vertices, const ProjectionParams& params, cv::Mat& counts) {
+    ProjectionParams quantized = params.forQuantized(vertices.origin(), vertices.step());
+    const uint16_t* qx = vertices.componentData(0);
+    const uint16_t* qy = vertices.componentData(1);
+    const uint16_t* qz = vertices.componentData(2);
+    size_t stride = vertices.stride();
+    if (vertices.isContiguous()) {
+        accumulateParallel(vertices.size(), params, counts, [&](size_t first, size_t n, uint32_t* out) {
+            accumulateProjection(qx + first, qy + first, qz + first, n, quantized, out);
+        });
+        return;
+    }
+
+    accumulateParallel(vertices.size(), params, counts, [&](size_t first, size_t n, uint32_t* out) {
+        uint16_t bx[accumulationBlockSize], by[accumulationBlockSize], bz[accumulationBlockSize];
+        for (size_t done = 0; done < n; done += accumulationBlockSize) {
+            size_t m = std::min(accumulationBlockSize, n - done);
+            size_t offset = (first + done) * stride;
+            for (size_t i = 0; i < m; i++) {
+                bx[i] = qx[offset + i * stride];
+                by[i] = qy[offset + i * stride];
+                bz[i] = qz[offset + i * stride];
+            }
+            accumulateProjection(bx, by, bz, m, quantized, out);
+        }
+    });
+}
+
+void drawCoverage(cv::Mat& image, const cv::Mat& counts, const cv::Scalar& color, double alpha) {
+    CV_Assert(image.type() == CV_8UC3 && counts.type() == CV_32S && counts.size() == image.size());
+    float a = (float)alpha;
+    float blended[3];
+    for (int c = 0; c < 3; c++) {
+        blended[c] = a * (float)color[c];
+    }
+#pragma omp parallel for
+    for (int row = 0; row < image.rows; row++) {
+        unsigned char* pixel = image.ptr<unsigned char>(row);
+        const int* count = counts.ptr<int>(row);
+        for (int x = 0; x < image.cols; x++, pixel += 3) {
+            if (count[x] > 0) {
+                for (int c = 0; c < 3; c++) {
+                    pixel[c] = (unsigned char)(blended[c] + (1.f - a) * pixel[c] + 0.5f);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ProjectionKernel.h"
+#include "QuantizedVertexView.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Projette les sommets d'une vue avec cv::projectPoints. Une vue contigu est
+// passe telle quelle; une vue  pas quelconque est regroupe par blocs pour
+// limiter la mmoire temporaire.
+void projectVertices(const VertexView& vertices, const cv::Mat& rvec, const cv::Mat& tvec,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<cv::Point2f>& imagePoints);
+
+// Mme projection pour des sommets quantifis, dquantifis par blocs
+void projectVertices(const QuantizedVertexView& vertices, const cv::Mat& rvec, const cv::Mat& tvec,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<cv::Point2f>& imagePoints);
+
+// Projette tous les sommets avec le noyau vectoris et compte les sommets de
+// chaque pixel dans counts (CV_32S de la taille de l'image, cr  zro s'il
+// n'a pas cette forme, cumul sinon). Les vues  pas quelconque sont
+// regroupes par blocs en tableaux spars. Les grands maillages sont rpartis
+// entre les threads, chacun avec sa propre image de comptes.
+void accumulateVertices(const VertexView& vertices, const ProjectionParams& params, cv::Mat& counts);
+void accumulateVertices(const QuantizedVertexView& vertices, const ProjectionParams& params, cv::Mat& counts);
+
+// Surimpression de color (opacit alpha entre 0 et 1) sur les pixels o
+// counts > 0, lignes en parallle. image: CV_8UC3.
+void drawCoverage(cv::Mat& image, const cv::Mat& counts, const cv::Scalar& color, double alpha);
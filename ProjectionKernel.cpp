@@ -0,0 +1,169 @@
+#include "ProjectionKernel.h"
+
+#include <opencv2/calib3d.hpp>
+
+namespace {
+
+template <typename V>
+void accumulate(const V* x, const V* y, const V* z, size_t count, const ProjectionParams& p, uint32_t* counts) {
+    float maxU = p.width - 0.5f, maxV = p.height - 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        float u, v, depth;
+        if (!projectPoint(p, (float)x[i], (float)y[i], (float)z[i], u, v, depth)) {
+            continue;
+        }
+        if (u > -0.5f && u < maxU && v > -0.5f && v < maxV) {
+            counts[(size_t)cvRound(v) * p.width + cvRound(u)]++;
+        }
+    }
+}
+
+ProjectionKernel detectKernel() {
+    if (projectionKernelSupported(ProjectionKernel::AVX512)) {
+        return ProjectionKernel::AVX512;
+    }
+    if (projectionKernelSupported(ProjectionKernel::AVX2)) {
+        return ProjectionKernel::AVX2;
+    }
+    return ProjectionKernel::Scalar;
+}
+
+template <typename V>
+void dispatch(ProjectionKernel kernel, const V* x, const V* y, const V* z, size_t count, const ProjectionParams& params,
+    uint32_t* counts) {
+    switch (kernel) {
+#ifdef SIMPLEPNP_HAVE_AVX512
+    case ProjectionKernel::AVX512:
+        projectionkernel::accumulateAVX512(x, y, z, count, params, counts);
+        return;
+#endif
+#ifdef SIMPLEPNP_HAVE_AVX2
+    case ProjectionKernel::AVX2:
+        projectionkernel::accumulateAVX2(x, y, z, count, params, counts);
+        return;
+#endif
+    default:
+        projectionkernel::accumulateScalar(x, y, z, count, params, counts);
+    }
+}
+
+} // namespace
+
+ProjectionParams ProjectionParams::make(const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix,
+    const cv::Mat& distCoeffs, cv::Size imageSize) {
+    int distCount = (int)distCoeffs.total();
+    if (distCount != 0 && distCount != 4 && distCount != 5 && distCount != 8) {
+        CV_Error(cv::Error::StsBadArg, "Projection du maillage: 0, 4, 5 ou 8 coefficients de distorsion attendus");
+    }
+
+    ProjectionParams params;
+    cv::Mat R, t, K, dist;
+    cv::Rodrigues(rvec, R);
+    R.convertTo(R, CV_32F);
+    tvec.convertTo(t, CV_32F);
+    cameraMatrix.convertTo(K, CV_32F);
+    for (int i = 0; i < 9; i++) {
+        params.r[i] = R.at<float>(i / 3, i % 3);
+    }
+    for (int i = 0; i < 3; i++) {
+        params.t[i] = t.at<float>(i);
+    }
+    params.fx = K.at<float>(0, 0);
+    params.fy = K.at<float>(1, 1);
+    params.cx = K.at<float>(0, 2);
+    params.cy = K.at<float>(1, 2);
+    if (distCount > 0) {
+        distCoeffs.reshape(1, distCount).convertTo(dist, CV_32F);
+        for (int i = 0; i < distCount; i++) {
+            params.k[i] = dist.at<float>(i);
+            params.distorted = params.distorted || params.k[i] != 0.f;
+            params.rational = params.rational || (i >= 5 && params.k[i] != 0.f);
+        }
+    }
+    params.width = imageSize.width;
+    params.height = imageSize.height;
+    return params;
+}
+
+ProjectionParams ProjectionParams::forQuantized(const cv::Point3f& origin, const cv::Point3f& step) const {
+    ProjectionParams params = *this;
+    for (int row = 0; row < 3; row++) {
+        const float* rr = r + 3 * row;
+        params.r[3 * row] = rr[0] * step.x;
+        params.r[3 * row + 1] = rr[1] * step.y;
+        params.r[3 * row + 2] = rr[2] * step.z;
+        params.t[row] = rr[0] * origin.x + rr[1] * origin.y + rr[2] * origin.z + t[row];
+    }
+    return params;
+}
+
+ProjectionKernel projectionKernel() {
+    static const ProjectionKernel kernel = detectKernel();
+    return kernel;
+}
+
+bool projectionKernelSupported(ProjectionKernel kernel) {
+    switch (kernel) {
+#ifdef SIMPLEPNP_HAVE_AVX512
+    case ProjectionKernel::AVX512:
+        // /arch:AVX512 (MSVC) autorise aussi BW, DQ et VL dans le code gnr:
+        // toutes les extensions AVX-512 de Skylake-X sont exiges
+        return cv::checkHardwareSupport(CV_CPU_AVX_512F) && cv::checkHardwareSupport(CV_CPU_AVX512_SKX);
+#endif
+#ifdef SIMPLEPNP_HAVE_AVX2
+    case ProjectionKernel::AVX2:
+        return cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+#endif
+    case ProjectionKernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* projectionKernelName(ProjectionKernel kernel) {
+    switch (kernel) {
+    case ProjectionKernel::AVX2:
+        return "AVX2";
+    case ProjectionKernel::AVX512:
+        return "AVX-512";
+    default:
+        return "scalaire";
+    }
+}
+
+void accumulateProjection(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    dispatch(projectionKernel(), x, y, z, count, params, counts);
+}
+
+void accumulateProjection(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    dispatch(projectionKernel(), x, y, z, count, params, counts);
+}
+
+void accumulateProjection(ProjectionKernel kernel, const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    CV_Assert(projectionKernelSupported(kernel));
+    dispatch(kernel, x, y, z, count, params, counts);
+}
+
+void accumulateProjection(ProjectionKernel kernel, const uint16_t* x, const uint16_t* y, const uint16_t* z,
+    size_t count, const ProjectionParams& params, uint32_t* counts) {
+    CV_Assert(projectionKernelSupported(kernel));
+    dispatch(kernel, x, y, z, count, params, counts);
+}
+
+namespace projectionkernel {
+
+void accumulateScalar(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulate(x, y, z, count, params, counts);
+}
+
+void accumulateScalar(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulate(x, y, z, count, params, counts);
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Noyau de projection du maillage entier: transforme et projette (modle
+// stnop + distorsion OpenCV jusqu' 8 coefficients) des sommets rangs par
+// composante (x[], y[], z[]) et compte, pour chaque pixel de l'image, les
+// sommets qui y tombent. Les sommets derrire la camra ou hors de l'image sont
+// ignors. Le pixel d'un point est celui de ses coordonnes arrondies, comme
+// pour un cv::Point tir de cv::projectPoints.
+// Trois versions: scalaire, AVX2 et AVX-512, choisies  l'excution selon le
+// processeur (ProjectionKernelAVX2.cpp et ProjectionKernelAVX512.cpp sont
+// compils avec leurs propres options et partagent la boucle de
+// ProjectionKernelSimd.h).
+
+struct ProjectionParams {
+    float r[9] = { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f };  // rotation, par lignes
+    float t[3] = { 0.f, 0.f, 0.f };
+    float fx = 1.f, fy = 1.f, cx = 0.f, cy = 0.f;
+    float k[8] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };  // k1 k2 p1 p2 k3 k4 k5 k6
+    bool distorted = false;
+    bool rational = false;    // k4, k5 ou k6 non nuls
+    int width = 0;
+    int height = 0;
+
+    // Pose (rvec, tvec), K et distorsion (0, 4, 5 ou 8 coefficients) au format
+    // de cv::projectPoints
+    static ProjectionParams make(const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix,
+        const cv::Mat& distCoeffs, cv::Size imageSize);
+
+    // Mmes paramtres pour des sommets quantifis p = origin + q * step: la
+    // dquantification est intgre  la transformation
+    ProjectionParams forQuantized(const cv::Point3f& origin, const cv::Point3f& step) const;
+};
+
+// Projection d'un point (version scalaire du noyau). Retourne false si le
+// point est derrire la camra; u, v ne sont pas borns  l'image.
+inline bool projectPoint(const ProjectionParams& p, float X, float Y, float Z, float& u, float& v, float& depth) {
+    const float* r = p.r;
+    const float* k = p.k;
+    depth = r[6] * X + r[7] * Y + r[8] * Z + p.t[2];
+    if (!(depth > 0.f)) {
+        return false;
+    }
+    float iz = 1.f / depth;
+    float xn = (r[0] * X + r[1] * Y + r[2] * Z + p.t[0]) * iz;
+    float yn = (r[3] * X + r[4] * Y + r[5] * Z + p.t[1]) * iz;
+    if (p.distorted) {
+        float r2 = xn * xn + yn * yn;
+        float radial = 1.f + r2 * (k[0] + r2 * (k[1] + r2 * k[4]));
+        if (p.rational) {
+            radial /= 1.f + r2 * (k[5] + r2 * (k[6] + r2 * k[7]));
+        }
+        float xy = 2.f * xn * yn;
+        float xd = xn * radial + k[2] * xy + k[3] * (r2 + 2.f * xn * xn);
+        float yd = yn * radial + k[2] * (r2 + 2.f * yn * yn) + k[3] * xy;
+        xn = xd;
+        yn = yd;
+    }
+    u = p.fx * xn + p.cx;
+    v = p.fy * yn + p.cy;
+    return true;
+}
+
+enum class ProjectionKernel { Scalar, AVX2, AVX512 };
+
+// Version retenue pour ce processeur (dtermine au premier appel)
+ProjectionKernel projectionKernel();
+const char* projectionKernelName(ProjectionKernel kernel);
+// Version compile et utilisable sur ce processeur
+bool projectionKernelSupported(ProjectionKernel kernel);
+
+// Ajoute 1  counts[v * width + u] pour chaque sommet visible
+void accumulateProjection(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateProjection(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+// Mme chose avec une version impose (projectionKernelSupported(kernel) requis)
+void accumulateProjection(ProjectionKernel kernel, const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateProjection(ProjectionKernel kernel, const uint16_t* x, const uint16_t* y, const uint16_t* z,
+    size_t count, const ProjectionParams& params, uint32_t* counts);
+
+namespace projectionkernel {
+void accumulateScalar(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateScalar(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateAVX2(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateAVX2(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateAVX512(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+void accumulateAVX512(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts);
+}
@@ -0,0 +1,51 @@
+// Compil avec /arch:AVX2 (MSVC) ou -mavx2 -mfma: appel uniquement si le
+// processeur le permet (voir projectionKernel()).
+#include "ProjectionKernelSimd.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// 8 voies de 32 bits
+struct Avx2 {
+    using Float = __m256;
+    static constexpr int lanes = 8;
+
+    static Float set(float value) { return _mm256_set1_ps(value); }
+    static Float load(const float* p) { return _mm256_loadu_ps(p); }
+    static Float load(const uint16_t* p) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+    }
+    static Float fmadd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+
+    static unsigned visible(Float depth, Float u, Float v, Float minPixel, Float maxU, Float maxV) {
+        Float inside = _mm256_and_ps(_mm256_cmp_ps(depth, _mm256_setzero_ps(), _CMP_GT_OQ),
+            _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u, minPixel, _CMP_GT_OQ), _mm256_cmp_ps(u, maxU, _CMP_LT_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(v, minPixel, _CMP_GT_OQ), _mm256_cmp_ps(v, maxV, _CMP_LT_OQ))));
+        return (unsigned)_mm256_movemask_ps(inside);
+    }
+
+    static void pixelIndices(Float u, Float v, int width, int32_t* indices) {
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtps_epi32(v), _mm256_set1_epi32(width)),
+            _mm256_cvtps_epi32(u));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(indices), index);
+    }
+};
+
+} // namespace
+
+namespace projectionkernel {
+
+void accumulateAVX2(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulateSimd<Avx2>(x, y, z, count, params, counts);
+}
+
+void accumulateAVX2(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulateSimd<Avx2>(x, y, z, count, params, counts);
+}
+
+}
@@ -0,0 +1,53 @@
+// Compil avec /arch:AVX512 (MSVC) ou -mavx512f -mfma: appel uniquement si le
+// processeur le permet (voir projectionKernel()).
+#include "ProjectionKernelSimd.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// 16 voies de 32 bits; seules des instructions AVX-512F sont utilises
+struct Avx512 {
+    using Float = __m512;
+    static constexpr int lanes = 16;
+
+    static Float set(float value) { return _mm512_set1_ps(value); }
+    static Float load(const float* p) { return _mm512_loadu_ps(p); }
+    static Float load(const uint16_t* p) {
+        return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))));
+    }
+    static Float fmadd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+    static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+
+    static unsigned visible(Float depth, Float u, Float v, Float minPixel, Float maxU, Float maxV) {
+        __mmask16 mask = _mm512_cmp_ps_mask(depth, _mm512_setzero_ps(), _CMP_GT_OQ);
+        mask = _mm512_mask_cmp_ps_mask(mask, u, minPixel, _CMP_GT_OQ);
+        mask = _mm512_mask_cmp_ps_mask(mask, u, maxU, _CMP_LT_OQ);
+        mask = _mm512_mask_cmp_ps_mask(mask, v, minPixel, _CMP_GT_OQ);
+        mask = _mm512_mask_cmp_ps_mask(mask, v, maxV, _CMP_LT_OQ);
+        return (unsigned)mask;
+    }
+
+    static void pixelIndices(Float u, Float v, int width, int32_t* indices) {
+        __m512i index = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_cvtps_epi32(v), _mm512_set1_epi32(width)),
+            _mm512_cvtps_epi32(u));
+        _mm512_store_si512(indices, index);
+    }
+};
+
+} // namespace
+
+namespace projectionkernel {
+
+void accumulateAVX512(const float* x, const float* y, const float* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulateSimd<Avx512>(x, y, z, count, params, counts);
+}
+
+void accumulateAVX512(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+    const ProjectionParams& params, uint32_t* counts) {
+    accumulateSimd<Avx512>(x, y, z, count, params, counts);
+}
+
+}
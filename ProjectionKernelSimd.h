@@ -0,0 +1,73 @@
+#pragma once
+
+// Boucle commune des versions vectorielles du noyau de projection. Inclus
+// seulement par ProjectionKernelAVX2.cpp et ProjectionKernelAVX512.cpp, qui
+// l'instancient avec leur jeu d'instructions dcrit par Simd:
+//   Float, lanes: type du registre et nombre de flottants qu'il contient
+//   set(f), load(const float*), load(const uint16_t*)
+//   fmadd(a, b, c) = a * b + c, mul, div
+//   visible(depth, u, v, minPixel, maxU, maxV): masque (bit i = voie i) des
+//       points devant la camra et dans l'image, par comparaisons ordonnes
+//       pour carter les NaN (profondeur nulle)
+//   pixelIndices(u, v, width, indices): arrondi(v) * width + arrondi(u)
+// La distorsion est la mme que dans projectPoint (version scalaire).
+#include "ProjectionKernel.h"
+
+namespace projectionkernel {
+
+template <typename Simd, typename V>
+void accumulateSimd(const V* x, const V* y, const V* z, size_t count, const ProjectionParams& p, uint32_t* counts) {
+    using Float = typename Simd::Float;
+    const Float r0 = Simd::set(p.r[0]), r1 = Simd::set(p.r[1]), r2 = Simd::set(p.r[2]);
+    const Float r3 = Simd::set(p.r[3]), r4 = Simd::set(p.r[4]), r5 = Simd::set(p.r[5]);
+    const Float r6 = Simd::set(p.r[6]), r7 = Simd::set(p.r[7]), r8 = Simd::set(p.r[8]);
+    const Float t0 = Simd::set(p.t[0]), t1 = Simd::set(p.t[1]), t2 = Simd::set(p.t[2]);
+    const Float fx = Simd::set(p.fx), fy = Simd::set(p.fy);
+    const Float cx = Simd::set(p.cx), cy = Simd::set(p.cy);
+    const Float k1 = Simd::set(p.k[0]), k2 = Simd::set(p.k[1]), p1 = Simd::set(p.k[2]);
+    const Float p2 = Simd::set(p.k[3]), k3 = Simd::set(p.k[4]), k4 = Simd::set(p.k[5]);
+    const Float k5 = Simd::set(p.k[6]), k6 = Simd::set(p.k[7]);
+    const Float one = Simd::set(1.f), two = Simd::set(2.f);
+    const Float minPixel = Simd::set(-0.5f);
+    const Float maxU = Simd::set(p.width - 0.5f), maxV = Simd::set(p.height - 0.5f);
+    alignas(64) int32_t indices[Simd::lanes];
+
+    size_t i = 0;
+    for (; i + Simd::lanes <= count; i += Simd::lanes) {
+        Float X = Simd::load(x + i), Y = Simd::load(y + i), Z = Simd::load(z + i);
+        Float zc = Simd::fmadd(r6, X, Simd::fmadd(r7, Y, Simd::fmadd(r8, Z, t2)));
+        Float iz = Simd::div(one, zc);
+        Float xn = Simd::mul(Simd::fmadd(r0, X, Simd::fmadd(r1, Y, Simd::fmadd(r2, Z, t0))), iz);
+        Float yn = Simd::mul(Simd::fmadd(r3, X, Simd::fmadd(r4, Y, Simd::fmadd(r5, Z, t1))), iz);
+        if (p.distorted) {
+            Float rr = Simd::fmadd(xn, xn, Simd::mul(yn, yn));
+            Float radial = Simd::fmadd(rr, Simd::fmadd(rr, Simd::fmadd(rr, k3, k2), k1), one);
+            if (p.rational) {
+                radial = Simd::div(radial, Simd::fmadd(rr, Simd::fmadd(rr, Simd::fmadd(rr, k6, k5), k4), one));
+            }
+            Float xy = Simd::mul(two, Simd::mul(xn, yn));
+            Float xd = Simd::fmadd(xn, radial,
+                Simd::fmadd(p1, xy, Simd::mul(p2, Simd::fmadd(two, Simd::mul(xn, xn), rr))));
+            Float yd = Simd::fmadd(yn, radial,
+                Simd::fmadd(p1, Simd::fmadd(two, Simd::mul(yn, yn), rr), Simd::mul(p2, xy)));
+            xn = xd;
+            yn = yd;
+        }
+        Float u = Simd::fmadd(fx, xn, cx);
+        Float v = Simd::fmadd(fy, yn, cy);
+
+        unsigned mask = Simd::visible(zc, u, v, minPixel, maxU, maxV);
+        if (mask == 0) {
+            continue;
+        }
+        Simd::pixelIndices(u, v, p.width, indices);
+        for (int lane = 0; lane < Simd::lanes; lane++) {
+            if (mask & (1u << lane)) {
+                counts[indices[lane]]++;
+            }
+        }
+    }
+    accumulateScalar(x + i, y + i, z + i, count - i, p, counts);
+}
+
+}
@@ -0,0 +1,48 @@
+#include "QuantizedVertexView.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace {
+const long long dequantizeBlockSize = 1 << 16;
+}
+
+void QuantizedVertexView::dequantize(cv::Point3f* out) const {
+    size_t i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    if (isContiguous()) {
+        // Un vecteur de 16 bits donne deux vecteurs de floats par composante,
+        // rentrelacs directement en x, y, z dans la sortie
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        cv::v_float32 originX = cv::vx_setall_f32(origin_.x), stepX = cv::vx_setall_f32(step_.x);
+        cv::v_float32 originY = cv::vx_setall_f32(origin_.y), stepY = cv::vx_setall_f32(step_.y);
+        cv::v_float32 originZ = cv::vx_setall_f32(origin_.z), stepZ = cv::vx_setall_f32(step_.z);
+        auto toFloat = [](const cv::v_uint32& q, const cv::v_float32& step, const cv::v_float32& origin) {
+            return cv::v_fma(cv::v_cvt_f32(cv::v_reinterpret_as_s32(q)), step, origin);
+        };
+        for (; i + 2 * lanes <= count_; i += 2 * lanes) {
+            cv::v_uint32 x0, x1, y0, y1, z0, z1;
+            cv::v_expand(cv::vx_load(x_ + i), x0, x1);
+            cv::v_expand(cv::vx_load(y_ + i), y0, y1);
+            cv::v_expand(cv::vx_load(z_ + i), z0, z1);
+            cv::v_store_interleave(&out[i].x, toFloat(x0, stepX, originX), toFloat(y0, stepY, originY),
+                toFloat(z0, stepZ, originZ));
+            cv::v_store_interleave(&out[i + lanes].x, toFloat(x1, stepX, originX), toFloat(y1, stepY, originY),
+                toFloat(z1, stepZ, originZ));
+        }
+        cv::vx_cleanup();
+    }
+#endif
+    for (; i < count_; i++) {
+        out[i] = (*this)[i];
+    }
+}
+
+cv::Mat QuantizedVertexView::toCloud() const {
+    cv::Mat cloud(1, (int)count_, CV_32FC3);
+    cv::Point3f* out = cloud.ptr<cv::Point3f>();
+#pragma omp parallel for
+    for (long long first = 0; first < (long long)count_; first += dequantizeBlockSize) {
+        subview((size_t)first, (size_t)dequantizeBlockSize).dequantize(out + first);
+    }
+    return cloud;
+}
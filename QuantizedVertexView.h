@@ -0,0 +1,85 @@
+#pragma once
+
+#include "SpatialGrid.h"
+
+#include <opencv2/core.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Vue non propritaire sur des sommets quantifis sur 16 bits par composante,
+// relativement  une bote englobante: p = origin + q * step. Trois tableaux
+// spars qx[], qy[], qz[] (6 octets par sommet au lieu de 12), lus par les
+// traitements limits par la bande passante mmoire (affichage, projection du
+// maillage entier). La prcision est d'un demi-pas, soit la taille de la bote
+// divise par 131070.
+class QuantizedVertexView {
+public:
+    static const int levels = 65535;
+
+    QuantizedVertexView() = default;
+    QuantizedVertexView(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count,
+        const cv::Point3f& origin, const cv::Point3f& step)
+        : QuantizedVertexView(x, y, z, count, 1, origin, step) {}
+
+    // Pas de quantification couvrant la bote (1 pour un axe de taille nulle)
+    static cv::Point3f quantizationStep(const BoundingBox& bounds) {
+        cv::Point3f size = bounds.size();
+        return cv::Point3f(size.x > 0.f ? size.x / levels : 1.f, size.y > 0.f ? size.y / levels : 1.f,
+            size.z > 0.f ? size.z / levels : 1.f);
+    }
+
+    static uint16_t quantize(float value, float origin, float step) {
+        float q = std::round((value - origin) / step);
+        return (uint16_t)(q < 0.f ? 0.f : (q > (float)levels ? (float)levels : q));
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    const cv::Point3f& origin() const { return origin_; }
+    const cv::Point3f& step() const { return step_; }
+    bool isContiguous() const { return stride_ == 1; }
+    size_t stride() const { return stride_; }    // en sommets
+    const uint16_t* componentData(int axis) const { return axis == 0 ? x_ : (axis == 1 ? y_ : z_); }
+
+    cv::Point3f operator[](size_t i) const {
+        size_t k = i * stride_;
+        return cv::Point3f(origin_.x + x_[k] * step_.x, origin_.y + y_[k] * step_.y, origin_.z + z_[k] * step_.z);
+    }
+
+    // Un sommet sur "step", sans copie
+    QuantizedVertexView subsample(size_t step) const {
+        step = step < 1 ? 1 : step;
+        return QuantizedVertexView(x_, y_, z_, (count_ + step - 1) / step, stride_ * step, origin_, step_);
+    }
+
+    // Sommets [first, first + count), sans copie
+    QuantizedVertexView subview(size_t first, size_t count) const {
+        if (first >= count_) {
+            return QuantizedVertexView(x_, y_, z_, 0, stride_, origin_, step_);
+        }
+        count = count < count_ - first ? count : count_ - first;
+        size_t offset = first * stride_;
+        return QuantizedVertexView(x_ + offset, y_ + offset, z_ + offset, count, stride_, origin_, step_);
+    }
+
+    // Dquantifie toute la vue dans out (size() sommets). Vectoris avec les
+    // intrinsques universelles d'OpenCV quand la vue est contigu.
+    void dequantize(cv::Point3f* out) const;
+
+    // Nuage 1xN CV_32FC3 dquantifi (par blocs, en parallle)
+    cv::Mat toCloud() const;
+
+private:
+    QuantizedVertexView(const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count, size_t stride,
+        const cv::Point3f& origin, const cv::Point3f& step)
+        : x_(x), y_(y), z_(z), count_(count), stride_(stride), origin_(origin), step_(step) {}
+
+    const uint16_t* x_ = nullptr;
+    const uint16_t* y_ = nullptr;
+    const uint16_t* z_ = nullptr;
+    size_t count_ = 0;
+    size_t stride_ = 1;
+    cv::Point3f origin_;
+    cv::Point3f step_ = cv::Point3f(1.f, 1.f, 1.f);
+};
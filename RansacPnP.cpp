@@ -0,0 +1,353 @@
+#include "RansacPnP.h"
+#include "PoseRefiner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int hypothesesPerBatch = 64;
+const int localOptimizationSteps = 3;
+
+// SPRT: cot d'une estimation P3P en vrifications de points et nombre moyen
+// de solutions par chantillon (valeurs de Chum et Matas pour ce solveur)
+const double sprtModelCost = 200.0;
+const double sprtModelsPerSample = 2.0;
+const double sprtInitialDelta = 0.05;
+
+// Correspondances en coordonnes normalises (distorsion retire une fois pour
+// toutes); les carts sont remis en pixels avec fx, fy pour le seuil.
+struct NormalizedProblem {
+    const std::vector<cv::Point3f>* objectPoints;
+    std::vector<cv::Point2f> normalizedPoints;
+    double fx;
+    double fy;
+    double threshold2;
+    std::vector<int> verificationOrder;    // ordre alatoire fixe, pour que SPRT juge sur un chantillon non biais
+    std::vector<int> confidenceOrder;      // PROSAC: indices tris par confiance dcroissante
+    std::vector<int> prosacSizes;          // PROSAC: taille de l'ensemble chantillonn  chaque itration
+};
+
+// Test squentiel (SPRT): une hypothse est abandonne ds que le rapport de
+// vraisemblance "mauvais modle / bon modle" dpasse le seuil A.
+// epsilon: proportion de points cohrents avec un bon modle; delta: avec un mauvais.
+struct Sprt {
+    bool enabled = false;
+    double logInlier = 0.0;
+    double logOutlier = 0.0;
+    double logThreshold = 0.0;
+
+    void update(double epsilon, double delta) {
+        enabled = epsilon > delta && epsilon < 1.0;
+        if (!enabled) {
+            return;
+        }
+        logInlier = std::log(delta / epsilon);
+        logOutlier = std::log((1.0 - delta) / (1.0 - epsilon));
+        double C = (1.0 - delta) * logOutlier + delta * logInlier;
+        double K = sprtModelCost * C / sprtModelsPerSample + 1.0;
+        double A = K;
+        for (int i = 0; i < 10; i++) {
+            A = K + std::log(A);
+        }
+        logThreshold = std::log(A);
+    }
+};
+
+// Compteurs d'une itration, cumuls dans le rsultat
+struct VerificationStats {
+    int models = 0;
+    int rejected = 0;
+    long long points = 0;
+    double rejectedInlierRatio = 0.0;    // somme sur les modles rejets, pour estimer delta
+};
+
+struct Hypothesis {
+    cv::Vec3d rvec;
+    cv::Vec3d tvec;
+    int inliers = -1;
+    double cost = std::numeric_limits<double>::max();    // MSAC: erreurs tronques au seuil
+    VerificationStats stats;
+
+    bool betterThan(const Hypothesis& other) const {
+        return inliers > other.inliers || (inliers == other.inliers && cost < other.cost);
+    }
+};
+
+// Compte les points cohrents avec h. Avec sprt, les points sont vus dans un
+// ordre alatoire et l'valuation s'arrte ds que h est juge mauvaise
+// (retourne false, h.inliers = -1).
+bool score(const NormalizedProblem& problem, Hypothesis& h, std::vector<unsigned char>* mask = nullptr,
+    const Sprt* sprt = nullptr, VerificationStats* stats = nullptr) {
+    cv::Matx33d R;
+    cv::Rodrigues(h.rvec, R);
+    const std::vector<cv::Point3f>& object = *problem.objectPoints;
+    bool sequential = sprt && sprt->enabled;
+    h.inliers = 0;
+    h.cost = 0.0;
+    if (mask) {
+        mask->assign(object.size(), 0);
+    }
+    if (stats) {
+        stats->models++;
+    }
+    double logLambda = 0.0;
+    for (size_t k = 0; k < object.size(); k++) {
+        size_t i = sequential ? (size_t)problem.verificationOrder[k] : k;
+        const cv::Point3f& X = object[i];
+        double x = R(0, 0) * X.x + R(0, 1) * X.y + R(0, 2) * X.z + h.tvec[0];
+        double y = R(1, 0) * X.x + R(1, 1) * X.y + R(1, 2) * X.z + h.tvec[1];
+        double z = R(2, 0) * X.x + R(2, 1) * X.y + R(2, 2) * X.z + h.tvec[2];
+        double error2 = problem.threshold2;
+        if (z > 0.0) {
+            double dx = (x / z - problem.normalizedPoints[i].x) * problem.fx;
+            double dy = (y / z - problem.normalizedPoints[i].y) * problem.fy;
+            error2 = std::min(dx * dx + dy * dy, problem.threshold2);
+        }
+        bool inlier = error2 < problem.threshold2;
+        if (inlier) {
+            h.inliers++;
+            if (mask) {
+                (*mask)[i] = 1;
+            }
+        }
+        h.cost += error2;
+
+        if (sequential) {
+            logLambda += inlier ? sprt->logInlier : sprt->logOutlier;
+            if (logLambda > sprt->logThreshold) {
+                if (stats) {
+                    stats->points += k + 1;
+                    stats->rejected++;
+                    stats->rejectedInlierRatio += (double)h.inliers / (k + 1);
+                }
+                h.inliers = -1;
+                h.cost = std::numeric_limits<double>::max();
+                return false;
+            }
+        }
+    }
+    if (stats) {
+        stats->points += object.size();
+    }
+    return true;
+}
+
+// Tailles PROSAC: l'ensemble chantillonn (les n meilleures correspondances)
+// grandit de 3  N au rythme prvu par Chum et Matas pour maxIterations tirages
+std::vector<int> prosacSchedule(int n, int maxIterations) {
+    const int m = 3;
+    std::vector<int> sizes(maxIterations, n);
+    double Tn = maxIterations;
+    for (int i = 0; i < m; i++) {
+        Tn *= (double)(m - i) / (n - i);
+    }
+    int size = m;
+    double TnPrime = 1.0;
+    for (int t = 1; t <= maxIterations; t++) {
+        while (t > TnPrime && size < n) {
+            double Tn1 = Tn * (size + 1) / (size + 1 - m);
+            TnPrime += std::ceil(Tn1 - Tn);
+            Tn = Tn1;
+            size++;
+        }
+        sizes[t - 1] = size;
+    }
+    return sizes;
+}
+
+// Meilleure des solutions P3P d'un chantillon minimal tir pour l'itration
+Hypothesis hypothesize(const NormalizedProblem& problem, int iteration, const RansacPnPParams& params, const Sprt& sprt) {
+    const std::vector<cv::Point3f>& object = *problem.objectPoints;
+    int n = (int)object.size();
+    cv::RNG rng(params.seed * 6364136223846793005ull + (uint64_t)iteration + 1);
+    int sample[3];
+    int prosacSize = problem.prosacSizes.empty() ? n : problem.prosacSizes[iteration];
+    if (prosacSize < n) {
+        // PROSAC: la n-ime meilleure correspondance et deux parmi les prcdentes
+        sample[0] = problem.confidenceOrder[prosacSize - 1];
+        int a = rng.uniform(0, prosacSize - 1), b;
+        do { b = rng.uniform(0, prosacSize - 1); } while (b == a);
+        sample[1] = problem.confidenceOrder[a];
+        sample[2] = problem.confidenceOrder[b];
+    }
+    else {
+        sample[0] = rng.uniform(0, n);
+        do { sample[1] = rng.uniform(0, n); } while (sample[1] == sample[0]);
+        do { sample[2] = rng.uniform(0, n); } while (sample[2] == sample[0] || sample[2] == sample[1]);
+    }
+
+    std::vector<cv::Point3f> sampleObject(3);
+    std::vector<cv::Point2f> sampleImage(3);
+    for (int k = 0; k < 3; k++) {
+        sampleObject[k] = object[sample[k]];
+        sampleImage[k] = problem.normalizedPoints[sample[k]];
+    }
+
+    Hypothesis best;
+    VerificationStats stats;
+    std::vector<cv::Mat> rvecs, tvecs;
+    try {
+        int solutions = cv::solveP3P(sampleObject, sampleImage, cv::Matx33d::eye(), cv::Mat(), rvecs, tvecs,
+            params.minimalSolver);
+        for (int s = 0; s < solutions; s++) {
+            Hypothesis h;
+            h.rvec = cv::Vec3d(rvecs[s].at<double>(0), rvecs[s].at<double>(1), rvecs[s].at<double>(2));
+            h.tvec = cv::Vec3d(tvecs[s].at<double>(0), tvecs[s].at<double>(1), tvecs[s].at<double>(2));
+            if (score(problem, h, nullptr, &sprt, &stats) && h.betterThan(best)) {
+                best = h;
+            }
+        }
+    }
+    catch (const cv::Exception&) {
+        // chantillon dgnr (points aligns...): hypothse ignore
+    }
+    best.stats = stats;
+    return best;
+}
+
+// LO-RANSAC: raffinement itratif sur les correspondances gardes tant que
+// leur nombre augmente
+void localOptimize(const NormalizedProblem& problem, Hypothesis& h) {
+    const std::vector<cv::Point3f>& object = *problem.objectPoints;
+    std::vector<unsigned char> mask;
+    for (int step = 0; step < localOptimizationSteps; step++) {
+        score(problem, h, &mask);
+        if (h.inliers < 4) {
+            return;
+        }
+        Hypothesis refined = h;
+        refinePoseNormalized<double, float, float>(object.data(), problem.normalizedPoints.data(), mask.data(),
+            object.size(), problem.fx, problem.fy, refined.rvec, refined.tvec);
+        score(problem, refined);
+        if (!refined.betterThan(h)) {
+            return;
+        }
+        h = refined;
+    }
+}
+
+// Nombre d'itrations ncessaire pour tirer un chantillon sans erreur avec la
+// confiance demande, vu la proportion de correspondances gardes
+int requiredIterations(int inliers, int total, const RansacPnPParams& params) {
+    double w = (double)inliers / total;
+    double p = w * w * w;
+    if (p >= 1.0) {
+        return 0;
+    }
+    if (p <= 0.0) {
+        return params.maxIterations;
+    }
+    double n = std::log(1.0 - params.confidence) / std::log(1.0 - p);
+    return (int)std::min<double>(params.maxIterations, std::ceil(n));
+}
+
+} // namespace
+
+RansacPnPResult solvePnPRansacParallel(const std::vector<cv::Point3f>& objectPoints,
+    const std::vector<cv::Point2f>& imagePoints, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs,
+    const RansacPnPParams& params, const std::vector<float>& confidences) {
+    CV_Assert(objectPoints.size() == imagePoints.size());
+    CV_Assert(confidences.empty() || confidences.size() == objectPoints.size());
+    RansacPnPResult result;
+    int n = (int)objectPoints.size();
+    if (n < 4) {
+        return result;
+    }
+
+    NormalizedProblem problem;
+    problem.objectPoints = &objectPoints;
+    cv::undistortPoints(imagePoints, problem.normalizedPoints, cameraMatrix, distCoeffs);
+    cv::Mat K;
+    cameraMatrix.convertTo(K, CV_64F);
+    problem.fx = K.at<double>(0, 0);
+    problem.fy = K.at<double>(1, 1);
+    problem.threshold2 = params.reprojectionThreshold * params.reprojectionThreshold;
+
+    problem.verificationOrder.resize(n);
+    for (int i = 0; i < n; i++) {
+        problem.verificationOrder[i] = i;
+    }
+    cv::RNG orderRng(params.seed);
+    for (int i = n - 1; i > 0; i--) {
+        std::swap(problem.verificationOrder[i], problem.verificationOrder[orderRng.uniform(0, i + 1)]);
+    }
+    if (!confidences.empty() && params.maxIterations > 0) {
+        problem.confidenceOrder.resize(n);
+        for (int i = 0; i < n; i++) {
+            problem.confidenceOrder[i] = i;
+        }
+        std::stable_sort(problem.confidenceOrder.begin(), problem.confidenceOrder.end(),
+            [&](int a, int b) { return confidences[a] > confidences[b]; });
+        problem.prosacSizes = prosacSchedule(n, params.maxIterations);
+    }
+
+    // Les hypothses d'un lot sont calcules en parallle, puis parcourues dans
+    // l'ordre des itrations: le choix ne dpend pas de l'ordonnancement.
+    // Les paramtres SPRT ne changent qu'entre deux lots, pour la mme raison;
+    // le premier lot est vrifi en entier (aucune estimation d'epsilon encore).
+    Hypothesis best;
+    Sprt sprt;
+    double delta = sprtInitialDelta;
+    int required = params.maxIterations;
+    int iteration = 0;
+    std::vector<Hypothesis> batch;
+    while (iteration < required) {
+        int count = std::min(hypothesesPerBatch, required - iteration);
+        batch.assign(count, Hypothesis());
+#pragma omp parallel for schedule(dynamic) if(params.parallel)
+        for (int k = 0; k < count; k++) {
+            batch[k] = hypothesize(problem, iteration + k, params, sprt);
+        }
+
+        for (int k = 0; k < count; k++) {
+            const VerificationStats& stats = batch[k].stats;
+            result.hypotheses += stats.models;
+            result.rejectedEarly += stats.rejected;
+            result.verifiedPoints += stats.points;
+            if (stats.rejected > 0) {
+                // delta: moyenne glissante de la proportion de points cohrents avec les modles rejets
+                delta = std::min(0.5, std::max(0.001, 0.95 * delta + 0.05 * stats.rejectedInlierRatio / stats.rejected));
+            }
+            if (batch[k].betterThan(best)) {
+                best = batch[k];
+                if (params.localOptimization) {
+                    localOptimize(problem, best);
+                }
+                required = std::max(iteration + count, requiredIterations(best.inliers, n, params));
+            }
+        }
+        iteration += count;
+        if (params.sprt && best.inliers > 0) {
+            sprt.update((double)best.inliers / n, delta);
+        }
+    }
+    result.iterations = iteration;
+    if (best.inliers < 4) {
+        return result;
+    }
+
+    // Raffinement final en pixels sur toutes les correspondances gardes
+    std::vector<unsigned char> mask;
+    score(problem, best, &mask);
+    refinePoseNormalized<double, float, float>(objectPoints.data(), problem.normalizedPoints.data(), mask.data(),
+        objectPoints.size(), problem.fx, problem.fy, best.rvec, best.tvec);
+    cv::Mat rvec = cv::Mat(best.rvec).clone();
+    cv::Mat tvec = cv::Mat(best.tvec).clone();
+
+    std::vector<cv::Point2f> projected;
+    cv::projectPoints(objectPoints, rvec, tvec, cameraMatrix, distCoeffs, projected);
+    result.inlierMask.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+        cv::Point2f d = projected[i] - imagePoints[i];
+        if (d.x * d.x + d.y * d.y < problem.threshold2) {
+            result.inlierMask[i] = 1;
+            result.inlierCount++;
+        }
+    }
+    result.rvec = rvec;
+    result.tvec = tvec;
+    result.success = result.inlierCount >= 4;
+    return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+#include <cstdint>
+#include <vector>
+
+struct RansacPnPParams {
+    double reprojectionThreshold = 8.0;   // pixels
+    double confidence = 0.99;
+    int maxIterations = 1000;
+    uint64_t seed = 0;                    // mme graine, mmes donnes: mme rsultat
+    int minimalSolver = cv::SOLVEPNP_AP3P; // SOLVEPNP_P3P ou SOLVEPNP_AP3P
+    bool localOptimization = true;        // LO-RANSAC: raffinement de chaque nouvelle meilleure hypothse
+    bool sprt = true;                     // abandon anticip des hypothses manifestement mauvaises
+    bool parallel = true;                 // false quand l'appelant est dj parallle (batch)
+};
+
+struct RansacPnPResult {
+    bool success = false;
+    cv::Mat rvec;
+    cv::Mat tvec;
+    std::vector<unsigned char> inlierMask;    // 1 par correspondance garde
+    int inlierCount = 0;
+    int iterations = 0;
+    // Compteurs de vrification: sans SPRT, verifiedPoints = hypotheses * N
+    int hypotheses = 0;           // solutions P3P values
+    int rejectedEarly = 0;        // abandonnes par SPRT avant la fin
+    long long verifiedPoints = 0;
+};
+
+// PnP robuste aux correspondances errones. Les hypothses sont calcules sur
+// des chantillons minimaux de 3 points (cv::solveP3P) et values par lots en
+// parallle. L'chantillon de l'itration i ne dpend que de la graine et de i:
+// le rsultat ne dpend pas du nombre de threads. La pose finale est raffine
+// (Levenberg-Marquardt de PoseRefiner.h) sur toutes les correspondances gardes.
+// Avec des confiances (une par correspondance, issues de l'appariement), les
+// chantillons sont tirs d'abord parmi les plus sres (PROSAC). Avec SPRT,
+// une hypothse est abandonne aprs quelques points si elle est mauvaise.
+RansacPnPResult solvePnPRansacParallel(const std::vector<cv::Point3f>& objectPoints,
+    const std::vector<cv::Point2f>& imagePoints, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs,
+    const RansacPnPParams& params = RansacPnPParams(), const std::vector<float>& confidences = std::vector<float>());
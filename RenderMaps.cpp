@@ -0,0 +1,54 @@
+#include "RenderMaps.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <cmath>
+#include <cstdint>
+
+bool writeRenderMaps(const std::string& prefix, const MeshRasterizer& rasterizer, const RenderBuffers& buffers,
+    const ProjectionParams& params, double depthScale) {
+    const int rows = buffers.depth.rows, cols = buffers.depth.cols;
+    cv::Mat depth(rows, cols, CV_32F), depth16(rows, cols, CV_16U), normals16(rows, cols, CV_16UC3);
+    cv::Mat faces(rows, cols, CV_16UC3);
+    cv::Mat normals;
+    rasterizer.normalMap(buffers, params, normals);
+
+#pragma omp parallel for
+    for (int y = 0; y < rows; y++) {
+        const float* renderedDepth = buffers.depth.ptr<float>(y);
+        const int* triangles = buffers.triangles.ptr<int>(y);
+        const cv::Vec3f* normal = normals.ptr<cv::Vec3f>(y);
+        float* depthRow = depth.ptr<float>(y);
+        uint16_t* depth16Row = depth16.ptr<uint16_t>(y);
+        uint16_t* normalRow = normals16.ptr<uint16_t>(y);
+        uint16_t* faceRow = faces.ptr<uint16_t>(y);
+        for (int x = 0; x < cols; x++) {
+            bool surface = triangles[x] >= 0;
+            float d = surface ? renderedDepth[x] : 0.f;
+            depthRow[x] = d;
+            double scaled = std::round(d * depthScale);
+            depth16Row[x] = (uint16_t)(scaled > 65535.0 ? 65535.0 : scaled);
+
+            // BGR: z, y, x
+            for (int c = 0; c < 3; c++) {
+                normalRow[3 * x + c] = surface ? (uint16_t)std::lround((normal[x][2 - c] + 1.f) * 0.5f * 65535.f) : 0;
+            }
+
+            uint32_t id = surface ? (uint32_t)rasterizer.face((size_t)triangles[x]) + 1 : 0;
+            faceRow[3 * x] = (uint16_t)(id & 0xFFFF);
+            faceRow[3 * x + 1] = (uint16_t)(id >> 16);
+            faceRow[3 * x + 2] = 0;
+        }
+    }
+
+    bool written = true;
+    try {
+        written = cv::imwrite(prefix + "_depth.tiff", depth) && written;
+        written = cv::imwrite(prefix + "_depth.png", depth16) && written;
+        written = cv::imwrite(prefix + "_normals.png", normals16) && written;
+        written = cv::imwrite(prefix + "_faces.png", faces) && written;
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+    return written;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "MeshRasterizer.h"
+
+#include <string>
+
+// Cartes d'un rendu du maillage depuis la pose estime, crites  ct de prefix:
+//   <prefix>_depth.tiff     profondeur camra en float32 (0 sans surface)
+//   <prefix>_depth.png      profondeur sur 16 bits: depth * depthScale, sature
+//                            65535 (0 sans surface)
+//   <prefix>_normals.png    normales dans le repre camra sur 16 bits:
+//                           (n + 1) / 2 * 65535, x en rouge, y en vert, z en bleu;
+//                           (0, 0, 0) sans surface (impossible pour une normale
+//                           unitaire), 32768 partout pour un triangle dgnr
+//   <prefix>_faces.png      indice de la face visible + 1 sur 32 bits, en BGR
+//                           16 bits: 16 bits de poids faible en bleu, de poids
+//                           fort en vert, rouge nul (0 sans surface)
+// Retourne false si un des fichiers n'a pas pu tre crit.
+bool writeRenderMaps(const std::string& prefix, const MeshRasterizer& rasterizer, const RenderBuffers& buffers,
+    const ProjectionParams& params, double depthScale);
@@ -0,0 +1,653 @@
+#include "SelfCheck.h"
+#include "MeshCache.h"
+#include "MeshRasterizer.h"
+#include "MeshWelding.h"
+#include "PlyReader.h"
+#include "PoseRefiner.h"
+#include "ProjectionKernel.h"
+#include "RansacPnP.h"
+#include "TriangleBvh.h"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+const uint64_t selfCheckSeed = 20240617;
+
+// Bilan des contrles: chaque contrle est affich avec sa valeur mesure
+class CheckReport {
+public:
+    void expect(bool condition, const std::string& what, double measured) {
+        std::ostringstream line;
+        line << (condition ? "  OK     " : "  CHEC  ") << what << " (" << measured << ")";
+        std::cout << line.str() << std::endl;
+        failures_ += condition ? 0 : 1;
+    }
+
+    void fail(const std::string& what) {
+        std::cout << "  CHEC  " << what << std::endl;
+        failures_++;
+    }
+
+    int failures() const { return failures_; }
+
+private:
+    int failures_ = 0;
+};
+
+cv::Mat vec3(double x, double y, double z) {
+    cv::Mat v(3, 1, CV_64F);
+    double* p = v.ptr<double>();
+    p[0] = x;
+    p[1] = y;
+    p[2] = z;
+    return v;
+}
+
+cv::Vec3d toVec(const cv::Mat& v) {
+    const double* p = v.ptr<double>();
+    return cv::Vec3d(p[0], p[1], p[2]);
+}
+
+// Angle (radians) de la rotation qui fait passer de a  b
+double rotationError(const cv::Mat& a, const cv::Mat& b) {
+    cv::Matx33d Ra = poserefiner::rotationFromVector(toVec(a));
+    cv::Matx33d Rb = poserefiner::rotationFromVector(toVec(b));
+    cv::Vec3d r = poserefiner::vectorFromRotation(cv::Matx33d(Ra.t() * Rb));
+    return std::sqrt(r.dot(r));
+}
+
+double distance(const cv::Mat& a, const cv::Mat& b) {
+    cv::Vec3d d = toVec(a) - toVec(b);
+    return std::sqrt(d.dot(d));
+}
+
+// Correspondances synthtiques: points dans une bote devant la camra,
+// projets avec distorsion puis bruits (bruit uniforme de +-noise pixels).
+// Une proportion outlierRatio des points 2D est remplace par des pixels
+// quelconques de l'image.
+struct SyntheticScene {
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeffs;
+    cv::Mat rvec;
+    cv::Mat tvec;
+    std::vector<cv::Point3f> objectPoints;
+    std::vector<cv::Point2f> imagePoints;
+    std::vector<unsigned char> outliers;
+};
+
+SyntheticScene makeScene(int count, double outlierRatio, double noise, uint64_t seed) {
+    const cv::Size imageSize(1280, 720);
+    SyntheticScene scene;
+    cv::Mat distCoeffs(5, 1, CV_64F);
+    double* k = distCoeffs.ptr<double>();
+    k[0] = -0.12;
+    k[1] = 0.03;
+    k[2] = 0.001;
+    k[3] = -0.0005;
+    k[4] = 0.0;
+    scene.cameraMatrix = cv::Mat(cv::Matx33d(1000, 0, 640, 0, 1000, 360, 0, 0, 1));
+    scene.distCoeffs = distCoeffs;
+    scene.rvec = vec3(0.2, -0.3, 0.1);
+    scene.tvec = vec3(0.1, -0.2, 4.0);
+
+    cv::RNG rng(seed);
+    for (int i = 0; i < count; i++) {
+        scene.objectPoints.push_back(cv::Point3f((float)rng.uniform(-1.0, 1.0), (float)rng.uniform(-0.7, 0.7),
+            (float)rng.uniform(-0.5, 0.5)));
+    }
+    cv::projectPoints(scene.objectPoints, scene.rvec, scene.tvec, scene.cameraMatrix, scene.distCoeffs,
+        scene.imagePoints);
+    scene.outliers.assign(count, 0);
+    for (int i = 0; i < count; i++) {
+        if (rng.uniform(0.0, 1.0) < outlierRatio) {
+            scene.outliers[i] = 1;
+            scene.imagePoints[i] = cv::Point2f((float)rng.uniform(0.0, (double)imageSize.width),
+                (float)rng.uniform(0.0, (double)imageSize.height));
+        }
+        else {
+            scene.imagePoints[i] += cv::Point2f((float)rng.uniform(-noise, noise), (float)rng.uniform(-noise, noise));
+        }
+    }
+    return scene;
+}
+
+// Erreur de reprojection en pixels (avec distorsion) sur les points non aberrants
+double reprojectionRms(const SyntheticScene& scene, const cv::Mat& rvec, const cv::Mat& tvec) {
+    std::vector<cv::Point2f> projected;
+    cv::projectPoints(scene.objectPoints, rvec, tvec, scene.cameraMatrix, scene.distCoeffs, projected);
+    double sum = 0.0;
+    size_t used = 0;
+    for (size_t i = 0; i < projected.size(); i++) {
+        if (!scene.outliers[i]) {
+            cv::Point2f d = projected[i] - scene.imagePoints[i];
+            sum += d.dot(d);
+            used++;
+        }
+    }
+    return used > 0 ? std::sqrt(sum / used) : 0.0;
+}
+
+void checkRansac(CheckReport& report) {
+    std::cout << "RANSAC sur 300 correspondances dont 30 % fausses" << std::endl;
+    SyntheticScene scene = makeScene(300, 0.3, 0.5, selfCheckSeed);
+    RansacPnPParams params;
+    params.seed = selfCheckSeed;
+    RansacPnPResult result = solvePnPRansacParallel(scene.objectPoints, scene.imagePoints, scene.cameraMatrix,
+        scene.distCoeffs, params);
+    if (!result.success) {
+        report.fail("aucune pose trouve");
+        return;
+    }
+
+    int missedInliers = 0, keptOutliers = 0;
+    for (size_t i = 0; i < scene.outliers.size(); i++) {
+        missedInliers += !scene.outliers[i] && !result.inlierMask[i] ? 1 : 0;
+        keptOutliers += scene.outliers[i] && result.inlierMask[i] ? 1 : 0;
+    }
+    report.expect(rotationError(result.rvec, scene.rvec) < 2e-3, "erreur de rotation (rad)",
+        rotationError(result.rvec, scene.rvec));
+    report.expect(distance(result.tvec, scene.tvec) < 5e-3 * cv::norm(toVec(scene.tvec)),
+        "erreur de translation", distance(result.tvec, scene.tvec));
+    report.expect(missedInliers == 0, "bonnes correspondances cartes", missedInliers);
+    report.expect(keptOutliers <= 2, "fausses correspondances gardes", keptOutliers);
+
+    // L'chantillon de chaque itration ne dpend que de la graine: mme
+    // rsultat sans paralllisme
+    params.parallel = false;
+    RansacPnPResult serial = solvePnPRansacParallel(scene.objectPoints, scene.imagePoints, scene.cameraMatrix,
+        scene.distCoeffs, params);
+    double difference = serial.success ? std::max(distance(serial.rvec, result.rvec), distance(serial.tvec, result.tvec))
+        : std::numeric_limits<double>::infinity();
+    report.expect(serial.success && serial.inlierMask == result.inlierMask && difference <= 1e-12,
+        "mme pose sans paralllisme (cart)", difference);
+}
+
+void checkRefiner(CheckReport& report) {
+    std::cout << "Raffinement compar  cv::solvePnPRefineLM" << std::endl;
+    SyntheticScene scene = makeScene(100, 0.0, 0.5, selfCheckSeed + 1);
+    cv::Mat initialRvec = vec3(0.22, -0.31, 0.115);
+    cv::Mat initialTvec = vec3(0.15, -0.23, 4.1);
+
+    PoseRefinerWorkspace<double> workspace;
+    cv::Mat rvec = initialRvec.clone(), tvec = initialTvec.clone();
+    PoseRefinerResult refined = refinePose(scene.objectPoints, scene.imagePoints, scene.cameraMatrix, scene.distCoeffs,
+        rvec, tvec, workspace);
+    cv::Mat referenceRvec = initialRvec.clone(), referenceTvec = initialTvec.clone();
+    cv::solvePnPRefineLM(scene.objectPoints, scene.imagePoints, scene.cameraMatrix, scene.distCoeffs, referenceRvec,
+        referenceTvec);
+
+    // Les deux minimisent l'cart en pixels, mesur avant ou aprs
+    // distorsion: les poses concident  la prcision du bruit prs
+    double rms = reprojectionRms(scene, rvec, tvec);
+    double referenceRms = reprojectionRms(scene, referenceRvec, referenceTvec);
+    report.expect(refined.converged, "convergence (itrations)", refined.iterations);
+    report.expect(rotationError(rvec, referenceRvec) < 1e-3, "cart de rotation (rad)",
+        rotationError(rvec, referenceRvec));
+    report.expect(distance(tvec, referenceTvec) < 1e-3 * cv::norm(toVec(referenceTvec)), "cart de translation",
+        distance(tvec, referenceTvec));
+    report.expect(rms <= referenceRms + 0.01, "erreur de reprojection (pixels)", rms);
+
+    // Sans bruit, la pose exacte est retrouve
+    SyntheticScene exact = makeScene(100, 0.0, 0.0, selfCheckSeed + 2);
+    rvec = initialRvec.clone();
+    tvec = initialTvec.clone();
+    refinePose(exact.objectPoints, exact.imagePoints, exact.cameraMatrix, exact.distCoeffs, rvec, tvec, workspace);
+    double error = std::max(rotationError(rvec, exact.rvec), distance(tvec, exact.tvec));
+    report.expect(error < 1e-5, "pose exacte retrouve sans bruit (cart)", error);
+}
+
+// Cube [-1, 1]^3, chaque face dcoupe en n x n carrs de deux triangles
+void makeCube(int n, std::vector<cv::Point3f>& vertices, std::vector<int>& polygons) {
+    auto addFace = [&](cv::Point3f origin, cv::Point3f du, cv::Point3f dv) {
+        int base = (int)vertices.size();
+        for (int j = 0; j <= n; j++) {
+            for (int i = 0; i <= n; i++) {
+                vertices.push_back(origin + du * (i / (float)n) + dv * (j / (float)n));
+            }
+        }
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                int a = base + j * (n + 1) + i;
+                int square[8] = { 3, a, a + 1, a + n + 2, 3, a, a + n + 2, a + n + 1 };
+                polygons.insert(polygons.end(), square, square + 8);
+            }
+        }
+    };
+    addFace(cv::Point3f(-1, -1, 1), cv::Point3f(2, 0, 0), cv::Point3f(0, 2, 0));
+    addFace(cv::Point3f(-1, -1, -1), cv::Point3f(2, 0, 0), cv::Point3f(0, 2, 0));
+    addFace(cv::Point3f(-1, -1, -1), cv::Point3f(2, 0, 0), cv::Point3f(0, 0, 2));
+    addFace(cv::Point3f(-1, 1, -1), cv::Point3f(2, 0, 0), cv::Point3f(0, 0, 2));
+    addFace(cv::Point3f(-1, -1, -1), cv::Point3f(0, 2, 0), cv::Point3f(0, 0, 2));
+    addFace(cv::Point3f(1, -1, -1), cv::Point3f(0, 2, 0), cv::Point3f(0, 0, 2));
+}
+
+void checkWelding(CheckReport& report) {
+    std::cout << "Soudure de sommets rpts trois fois" << std::endl;
+    // Grille au pas 1, chaque sommet rpt avec un dcalage bien infrieur 
+    // la tolrance (nombreux doublons de part et d'autre des bords de cellule)
+    const int side = 40;
+    const float relativeTolerance = 1e-5f;
+    std::vector<cv::Point3f> base;
+    for (int z = 0; z < 2; z++) {
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                base.push_back(cv::Point3f((float)x, (float)y, (float)z));
+            }
+        }
+    }
+    cv::RNG rng(selfCheckSeed);
+    std::vector<cv::Point3f> vertices = base;
+    for (int copy = 0; copy < 2; copy++) {
+        for (const cv::Point3f& p : base) {
+            vertices.push_back(p + cv::Point3f((float)rng.uniform(-1e-4, 1e-4), (float)rng.uniform(-1e-4, 1e-4),
+                (float)rng.uniform(-1e-4, 1e-4)));
+        }
+    }
+
+    std::vector<cv::Point3f> welded;
+    std::vector<uint32_t> remap;
+    weldVertices(VertexView(vertices), relativeTolerance, welded, remap);
+    size_t wrongRemap = remap.size() == vertices.size() ? 0 : vertices.size();
+    for (size_t i = 0; i < remap.size(); i++) {
+        wrongRemap += remap[i] == (uint32_t)(i % base.size()) ? 0 : 1;
+    }
+    report.expect(welded.size() == base.size(), "sommets aprs soudure", (double)welded.size());
+    report.expect(wrongRemap == 0, "sommets mal rattachs", (double)wrongRemap);
+
+    weldVertices(VertexView(base), relativeTolerance, welded, remap);
+    report.expect(welded.empty() && remap.empty(), "aucune copie sans doublon (sommets copis)", (double)welded.size());
+}
+
+void checkBvh(CheckReport& report) {
+    std::cout << "Rayons depuis l'intrieur d'un cube" << std::endl;
+    std::vector<cv::Point3f> vertices;
+    std::vector<int> polygons;
+    makeCube(8, vertices, polygons);
+    TriangleBvh bvh = TriangleBvh::build(VertexView(vertices), polygons.data(), polygons.size());
+
+    // Distance analytique jusqu' la premire face du cube
+    const cv::Point3f origin(0.1f, 0.2f, -0.3f);
+    cv::RNG rng(selfCheckSeed);
+    int misses = 0;
+    double maxError = 0.0;
+    for (int i = 0; i < 1000; i++) {
+        cv::Vec3f direction((float)rng.uniform(-1.0, 1.0), (float)rng.uniform(-1.0, 1.0), (float)rng.uniform(-1.0, 1.0));
+        float length = std::sqrt(direction.dot(direction));
+        if (length < 1e-3f) {
+            continue;
+        }
+        direction = direction * (1.f / length);
+        double expected = std::numeric_limits<double>::infinity();
+        const float o[3] = { origin.x, origin.y, origin.z };
+        for (int axis = 0; axis < 3; axis++) {
+            if (direction[axis] != 0.f) {
+                expected = std::min(expected, ((direction[axis] > 0.f ? 1.0 : -1.0) - o[axis]) / direction[axis]);
+            }
+        }
+        RayHit hit = bvh.intersect(origin, direction);
+        if (!hit.hit) {
+            misses++;
+            continue;
+        }
+        maxError = std::max(maxError, std::abs(hit.distance - expected));
+    }
+    report.expect(misses == 0, "rayons sans intersection", misses);
+    report.expect(maxError < 1e-4, "cart maximal  la distance exacte", maxError);
+}
+
+// Pixel de chaque point d'aprs cv::projectPoints, compt comme le fait
+// accumulateProjection (points tous devant la camra)
+std::vector<uint32_t> referenceCounts(const std::vector<cv::Point3f>& points, const cv::Mat& rvec, const cv::Mat& tvec,
+    const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, cv::Size size) {
+    std::vector<cv::Point2f> projected;
+    cv::projectPoints(points, rvec, tvec, cameraMatrix, distCoeffs, projected);
+    std::vector<uint32_t> counts((size_t)size.area(), 0);
+    for (const cv::Point2f& p : projected) {
+        if (p.x > -0.5f && p.x < size.width - 0.5f && p.y > -0.5f && p.y < size.height - 0.5f) {
+            counts[(size_t)cvRound(p.y) * size.width + cvRound(p.x)]++;
+        }
+    }
+    return counts;
+}
+
+// Sommets compts dans un autre pixel (chaque dplacement modifie deux pixels)
+size_t movedPoints(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    size_t difference = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        difference += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return (difference + 1) / 2;
+}
+
+void checkProjectionKernels(CheckReport& report) {
+    std::cout << "Noyaux de projection compars  la version scalaire et  cv::projectPoints" << std::endl;
+    // Points devant la camra dbordant de l'image; sommets en float et
+    // quantifis sur 16 bits (compars  leurs positions dquantifies)
+    const size_t count = 200003;    // pas multiple de 16: la fin passe par la version scalaire
+    const cv::Size size(640, 480);
+    const cv::Point3f origin(-3.f, -2.f, 2.f), step(6.f / 65535.f, 4.f / 65535.f, 4.f / 65535.f);
+    cv::RNG rng(selfCheckSeed);
+    std::vector<float> x(count), y(count), z(count);
+    std::vector<uint16_t> qx(count), qy(count), qz(count);
+    std::vector<cv::Point3f> points(count), dequantized(count);
+    for (size_t i = 0; i < count; i++) {
+        x[i] = (float)rng.uniform(-3.0, 3.0);
+        y[i] = (float)rng.uniform(-2.0, 2.0);
+        z[i] = (float)rng.uniform(2.0, 6.0);
+        points[i] = cv::Point3f(x[i], y[i], z[i]);
+        qx[i] = (uint16_t)rng.uniform(0, 65536);
+        qy[i] = (uint16_t)rng.uniform(0, 65536);
+        qz[i] = (uint16_t)rng.uniform(0, 65536);
+        dequantized[i] = cv::Point3f(origin.x + qx[i] * step.x, origin.y + qy[i] * step.y, origin.z + qz[i] * step.z);
+    }
+
+    cv::Mat cameraMatrix(cv::Matx33d(500, 0, 320, 0, 500, 240, 0, 0, 1));
+    cv::Mat rvec = vec3(0.05, -0.1, 0.03), tvec = vec3(0.1, 0.05, 0.2);
+    const double models[2][8] = {
+        { -0.12, 0.03, 0.001, -0.0005, 0.002, 0.0, 0.0, 0.0 },
+        { -0.12, 0.03, 0.001, -0.0005, 0.002, 0.02, -0.01, 0.005 },
+    };
+    const char* modelNames[2] = { "distorsion  5 coefficients", "modle rationnel" };
+    const ProjectionKernel kernels[3] = { ProjectionKernel::Scalar, ProjectionKernel::AVX2, ProjectionKernel::AVX512 };
+    for (int m = 0; m < 2; m++) {
+        cv::Mat distCoeffs(8, 1, CV_64F, const_cast<double*>(models[m]));
+        std::vector<uint32_t> expected = referenceCounts(points, rvec, tvec, cameraMatrix, distCoeffs, size);
+        std::vector<uint32_t> expectedQuantized = referenceCounts(dequantized, rvec, tvec, cameraMatrix, distCoeffs, size);
+        ProjectionParams params = ProjectionParams::make(rvec, tvec, cameraMatrix, distCoeffs, size);
+        ProjectionParams quantizedParams = params.forQuantized(origin, step);
+
+        std::vector<uint32_t> scalar, scalarQuantized;
+        for (ProjectionKernel kernel : kernels) {
+            if (!projectionKernelSupported(kernel)) {
+                std::cout << "  --     " << projectionKernelName(kernel) << ": non disponible" << std::endl;
+                continue;
+            }
+            std::vector<uint32_t> counts((size_t)size.area(), 0), quantizedCounts((size_t)size.area(), 0);
+            accumulateProjection(kernel, x.data(), y.data(), z.data(), count, params, counts.data());
+            accumulateProjection(kernel, qx.data(), qy.data(), qz.data(), count, quantizedParams, quantizedCounts.data());
+
+            // Arrondis diffrents (FMA, dquantification intgre): seuls
+            // quelques points  la limite de deux pixels peuvent changer
+            size_t moved = std::max(movedPoints(counts, expected), movedPoints(quantizedCounts, expectedQuantized));
+            std::ostringstream label;
+            label << projectionKernelName(kernel) << ", " << modelNames[m] << ": points dans un autre pixel que cv::projectPoints";
+            report.expect(moved <= count / 1000, label.str(), (double)moved);
+            if (kernel == ProjectionKernel::Scalar) {
+                scalar.swap(counts);
+                scalarQuantized.swap(quantizedCounts);
+                continue;
+            }
+            moved = std::max(movedPoints(counts, scalar), movedPoints(quantizedCounts, scalarQuantized));
+            label.str("");
+            label << projectionKernelName(kernel) << ", " << modelNames[m] << ": points dans un autre pixel que la version scalaire";
+            report.expect(moved <= count / 1000, label.str(), (double)moved);
+        }
+    }
+}
+
+// Fichier temporaire supprim  la fin du contrle (avec son cache ventuel)
+class TemporaryFile {
+public:
+    explicit TemporaryFile(const std::string& name) {
+        std::error_code error;
+        path_ = (std::filesystem::temp_directory_path(error) / name).string();
+    }
+    ~TemporaryFile() {
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+        std::filesystem::remove(MeshCache::cachePath(path_), error);
+    }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Valeur binaire dans l'ordre d'octets du fichier
+template <typename T>
+void writeBinary(std::ostream& out, T value, bool bigEndian) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    if (bigEndian != (std::endian::native == std::endian::big)) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    out.write(bytes, sizeof(T));
+}
+
+// PLY de test: sommets x, y, z suivis d'une couleur (enregistrements de 13
+// octets, non aligns), un lment intercal  sauter, puis des faces de 3 
+// 5 sommets suivies d'une proprit
+bool writeTestPly(const std::string& path, const std::string& format, const std::vector<cv::Point3f>& vertices,
+    const std::vector<int>& polygons) {
+    size_t faceCount = 0;
+    for (size_t i = 0; i < polygons.size(); i += polygons[i] + 1) {
+        faceCount++;
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "ply\nformat " << format << " 1.0\ncomment contrle automatique\n"
+        << "element vertex " << vertices.size() << "\nproperty float x\nproperty float y\nproperty float z\n"
+        << "property uchar red\nelement edge 2\nproperty int vertex1\nproperty int vertex2\n"
+        << "element face " << faceCount << "\nproperty list uchar int vertex_indices\nproperty uchar flags\n"
+        << "end_header\n";
+    bool ascii = format == "ascii", bigEndian = format == "binary_big_endian";
+    for (const cv::Point3f& v : vertices) {
+        if (ascii) {
+            out << v.x << " " << v.y << " " << v.z << " 200\n";
+        }
+        else {
+            writeBinary(out, v.x, bigEndian);
+            writeBinary(out, v.y, bigEndian);
+            writeBinary(out, v.z, bigEndian);
+            writeBinary(out, (unsigned char)200, bigEndian);
+        }
+    }
+    for (int edge = 0; edge < 2; edge++) {
+        if (ascii) {
+            out << edge << " " << edge + 1 << "\n";
+        }
+        else {
+            writeBinary(out, (int32_t)edge, bigEndian);
+            writeBinary(out, (int32_t)(edge + 1), bigEndian);
+        }
+    }
+    for (size_t i = 0; i < polygons.size(); i += polygons[i] + 1) {
+        if (ascii) {
+            for (int k = 0; k <= polygons[i]; k++) {
+                out << polygons[i + k] << " ";
+            }
+            out << "7\n";
+        }
+        else {
+            writeBinary(out, (unsigned char)polygons[i], bigEndian);
+            for (int k = 1; k <= polygons[i]; k++) {
+                writeBinary(out, (int32_t)polygons[i + k], bigEndian);
+            }
+            writeBinary(out, (unsigned char)7, bigEndian);
+        }
+    }
+    return (bool)out;
+}
+
+void checkPlyParsing(CheckReport& report) {
+    std::cout << "Lecture PLY ASCII et binaire (deux ordres d'octets)" << std::endl;
+    std::vector<cv::Point3f> vertices;
+    for (int i = 0; i < 9; i++) {
+        vertices.push_back(cv::Point3f(0.5f * i, -1.25f * i, 3.f - 0.75f * i));
+    }
+    const std::vector<int> polygons = { 3, 0, 1, 2, 4, 2, 3, 4, 5, 5, 4, 5, 6, 7, 8, 3, 8, 0, 4 };
+
+    const char* formats[3] = { "ascii", "binary_little_endian", "binary_big_endian" };
+    for (const char* format : formats) {
+        TemporaryFile file(std::string("simplepnp_selfcheck_") + format + ".ply");
+        if (!writeTestPly(file.path(), format, vertices, polygons)) {
+            report.fail(std::string("criture de ") + file.path());
+            continue;
+        }
+        PlyFile ply = PlyFile::load(file.path());
+        std::vector<cv::Point3f> read;
+        ply.vertices().copyTo(read);
+        size_t wrongVertices = read.size() == vertices.size() ? 0 : vertices.size();
+        for (size_t i = 0; i < read.size() && i < vertices.size(); i++) {
+            wrongVertices += read[i] == vertices[i] ? 0 : 1;
+        }
+        std::vector<int> readPolygons = ply.readPolygons();
+        report.expect(wrongVertices == 0, std::string(format) + ": sommets diffrents", (double)wrongVertices);
+        report.expect(readPolygons == polygons, std::string(format) + ": faces identiques (nombre de faces)",
+            (double)ply.faceCount());
+    }
+}
+
+void checkCacheRoundTrip(CheckReport& report) {
+    std::cout << "Cache du maillage: criture puis relecture d'un maillage soud" << std::endl;
+    // Cube dont chaque triangle a ses propres sommets (doublons souds), avec
+    // une face dgnre en tte, supprime par la soudure: les faces
+    // suivantes gardent leur indice du PLY
+    std::vector<cv::Point3f> cube;
+    std::vector<int> cubePolygons;
+    makeCube(4, cube, cubePolygons);
+    std::vector<cv::Point3f> vertices(3, cv::Point3f(0.25f, 0.5f, 0.75f));
+    std::vector<int> polygons = { 3, 0, 1, 2 };
+    for (size_t i = 0; i < cubePolygons.size(); i += cubePolygons[i] + 1) {
+        polygons.push_back(cubePolygons[i]);
+        for (int k = 1; k <= cubePolygons[i]; k++) {
+            polygons.push_back((int)vertices.size());
+            vertices.push_back(cube[cubePolygons[i + k]]);
+        }
+    }
+
+    TemporaryFile file("simplepnp_selfcheck_cache.ply");
+    if (!writeTestPly(file.path(), "binary_little_endian", vertices, polygons)) {
+        report.fail("criture de " + file.path());
+        return;
+    }
+    PlyFile ply = PlyFile::load(file.path());
+    const float tolerance = 1e-5f;
+    WeldedMesh welded = weldMesh(ply.vertices(), ply.readPolygons(), tolerance);
+    VertexView weldedVertices = welded.view(ply.vertices());
+    report.expect(welded.report.verticesAfter < welded.report.verticesBefore, "sommets aprs soudure",
+        (double)welded.report.verticesAfter);
+    report.expect(!welded.sourceFaces.empty() && welded.sourceFaces[0] == 1, "face du PLY de la premire face soude",
+        welded.sourceFaces.empty() ? -1.0 : (double)welded.sourceFaces[0]);
+
+    std::vector<uint32_t> samples = { 0, 5, 17, 3 };
+    if (!MeshCache::write(file.path(), ply, samples, 2, &welded)) {
+        report.fail("criture du cache");
+        return;
+    }
+    MeshCache cache;
+    if (!cache.open(file.path())) {
+        report.fail("ouverture du cache");
+        return;
+    }
+
+    std::vector<cv::Point3f> expected, read;
+    weldedVertices.copyTo(expected);
+    cache.vertices().copyTo(read);
+    report.expect(read == expected, "sommets relus (nombre)", (double)read.size());
+    report.expect(cache.polygonsSize() == welded.polygons.size() &&
+        std::equal(welded.polygons.begin(), welded.polygons.end(), cache.polygons()),
+        "faces relues (taille)", (double)cache.polygonsSize());
+    report.expect(cache.vertexRemap() != nullptr && cache.sourceVertexCount() == welded.vertexRemap.size() &&
+        std::equal(welded.vertexRemap.begin(), welded.vertexRemap.end(), cache.vertexRemap()),
+        "correspondance des sommets relue (sommets du PLY)", (double)cache.sourceVertexCount());
+    report.expect(cache.sourceFaces() != nullptr &&
+        std::equal(welded.sourceFaces.begin(), welded.sourceFaces.end(), cache.sourceFaces()),
+        "faces du PLY relues (faces)", (double)welded.sourceFaces.size());
+    report.expect(cache.sampleCount() == samples.size() && cache.keypointCount() == 2 &&
+        std::equal(samples.begin(), samples.end(), cache.sampleIndices()),
+        "sommets de slection relus", (double)cache.sampleCount());
+    report.expect(cache.weldTolerance() == tolerance, "tolrance de soudure relue", cache.weldTolerance());
+
+    // Les faces touches restent celles du PLY, avec ou sans cache
+    TriangleBvh bvh = TriangleBvh::build(cache.vertices(), cache.polygons(), cache.polygonsSize(), cache.sourceFaces());
+    RayHit hit = bvh.intersect(cv::Point3f(0.1f, 0.2f, 0.f), cv::Vec3f(0.f, 0.f, 1.f));
+    std::vector<cv::Vec3i> triangles;
+    std::vector<uint32_t> faces;
+    triangulatePolygons(polygons.data(), polygons.size(), vertices.size(), triangles, faces);
+    auto side = [](cv::Point3f a, cv::Point3f b, cv::Point3f p) {
+        return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    };
+    bool plyFace = false;
+    for (size_t t = 0; t < triangles.size() && hit.hit; t++) {
+        cv::Point3f a = vertices[triangles[t][0]], b = vertices[triangles[t][1]], c = vertices[triangles[t][2]];
+        // Triangle du dessus (z = 1) contenant le point touch
+        float ab = side(a, b, hit.point), bc = side(b, c, hit.point), ca = side(c, a, hit.point);
+        bool inside = (ab >= 0.f && bc >= 0.f && ca >= 0.f) || (ab <= 0.f && bc <= 0.f && ca <= 0.f);
+        if (a.z == 1.f && b.z == 1.f && c.z == 1.f && inside) {
+            plyFace = (faces.empty() ? t : faces[t]) == hit.face;
+            break;
+        }
+    }
+    report.expect(plyFace, "face du PLY touche par un rayon (indice)", hit.hit ? (double)hit.face : -1.0);
+}
+
+void checkRasterizer(CheckReport& report) {
+    std::cout << "Rendu d'un cube vu de l'intrieur" << std::endl;
+    std::vector<cv::Point3f> vertices;
+    std::vector<int> polygons;
+    makeCube(8, vertices, polygons);
+    MeshRasterizer rasterizer(VertexView(vertices), polygons.data(), polygons.size());
+
+    // Champ de 145 degrs depuis le centre, puis tout prs de la face z = 1
+    // (triangles dcoups au plan proche): aucun pixel sans surface
+    ProjectionParams params;
+    params.width = 640;
+    params.height = 480;
+    params.fx = params.fy = 100.f;
+    params.cx = 320.f;
+    params.cy = 240.f;
+    RenderBuffers buffers;
+    const float cameraZ[2] = { 0.f, 0.9f };
+    for (float z : cameraZ) {
+        params.t[2] = -z;
+        rasterizer.render(params, buffers);
+        int holes = 0;
+        for (int y = 0; y < buffers.triangles.rows; y++) {
+            const int* row = buffers.triangles.ptr<int>(y);
+            for (int x = 0; x < buffers.triangles.cols; x++) {
+                holes += row[x] < 0 ? 1 : 0;
+            }
+        }
+        std::ostringstream label;
+        label << "camra en z = " << z << ": pixels sans surface";
+        report.expect(holes == 0, label.str(), holes);
+        float depth = buffers.depth.ptr<float>(params.height / 2)[params.width / 2];
+        label.str("");
+        label << "camra en z = " << z << ": profondeur au centre";
+        report.expect(std::abs(depth - (1.f - z)) < 1e-4f, label.str(), depth);
+    }
+}
+}
+
+int runSelfCheck() {
+    CheckReport report;
+    void (*checks[])(CheckReport&) = { checkRansac, checkRefiner, checkWelding, checkBvh, checkRasterizer,
+        checkProjectionKernels, checkPlyParsing, checkCacheRoundTrip };
+    for (auto check : checks) {
+        try {
+            check(report);
+        }
+        catch (const cv::Exception& e) {
+            report.fail(std::string("exception: ") + e.what());
+        }
+    }
+
+    if (report.failures() > 0) {
+        std::cout << report.failures() << " contrle(s) en chec" << std::endl;
+        return -1;
+    }
+    std::cout << "Tous les contrles sont passs" << std::endl;
+    return 0;
+}
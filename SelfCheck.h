@@ -0,0 +1,21 @@
+#pragma once
+
+// Mode sans interface: SimplePnP --selfcheck. Vrifie les parties numriques
+// sur des donnes synthtiques tires avec une graine fixe (mme rsultat 
+// chaque excution; les seuls fichiers sont temporaires et supprims):
+//   - RANSAC (solvePnPRansacParallel) sur des correspondances dont 30 % sont
+//     fausses: pose retrouve, fausses correspondances cartes, mme
+//     rsultat sans paralllisme;
+//   - raffinement (refinePose) compar  cv::solvePnPRefineLM depuis une pose
+//     perturbe, et convergence exacte sans bruit;
+//   - soudure des sommets, rayons dans la BVH et rendu logiciel d'un cube vu
+//     de l'intrieur, compars aux valeurs analytiques;
+//   - chaque noyau de projection disponible (sommets float et 16 bits, avec
+//     distorsion  5 coefficients et modle rationnel) compar  la version
+//     scalaire et  cv::projectPoints;
+//   - lecture de PLY ASCII et binaires dans les deux ordres d'octets;
+//   - cache du maillage crit puis relu aprs soudure (correspondance des
+//     sommets et faces du PLY comprises).
+// Chaque contrle est affich avec la valeur mesure. Retourne le code de
+// sortie du programme (0 si tous les contrles passent).
+int runSelfCheck();
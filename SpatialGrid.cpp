@@ -0,0 +1,415 @@
+#include "SpatialGrid.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const int maxGridDim = 1024;
+const size_t maxGridCells = size_t(1) << 24;
+const size_t voxelEstimationSamples = 8;    // sommets du sous-chantillon par voxel vis
+const int voxelSearchIterations = 12;
+
+// Cl d'un voxel: 21 bits par axe
+inline uint64_t voxelKey(const cv::Point3f& p, const cv::Point3f& origin, float inverseSize) {
+    const float maxCoord = (float)((1 << 21) - 1);
+    uint64_t x = (uint64_t)std::max(0.f, std::min(maxCoord, std::floor((p.x - origin.x) * inverseSize)));
+    uint64_t y = (uint64_t)std::max(0.f, std::min(maxCoord, std::floor((p.y - origin.y) * inverseSize)));
+    uint64_t z = (uint64_t)std::max(0.f, std::min(maxCoord, std::floor((p.z - origin.z) * inverseSize)));
+    return (z << 42) | (y << 21) | x;
+}
+
+// Sommet retenu pour un voxel: le plus proche du centre,  galit le plus
+// petit indice (le rsultat ne dpend pas du nombre de threads)
+struct VoxelCandidate {
+    float distance;
+    uint32_t index;
+
+    bool betterThan(const VoxelCandidate& other) const {
+        return distance < other.distance || (distance == other.distance && index < other.index);
+    }
+};
+
+// Table de hachage  adressage ouvert voxel -> sommet retenu
+class VoxelTable {
+public:
+    explicit VoxelTable(size_t expected = 0) { reset(expected); }
+
+    void reset(size_t expected) {
+        int bits = 4;
+        while ((size_t(1) << bits) < 2 * expected) {
+            bits++;
+        }
+        shift_ = 64 - bits;
+        keys_.assign(size_t(1) << bits, emptyKey);
+        values_.resize(size_t(1) << bits);
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+
+    void insert(uint64_t key, const VoxelCandidate& candidate) {
+        if (2 * (size_ + 1) > keys_.size()) {
+            grow();
+        }
+        size_t mask = keys_.size() - 1;
+        size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift_);
+        while (keys_[slot] != emptyKey && keys_[slot] != key) {
+            slot = (slot + 1) & mask;
+        }
+        if (keys_[slot] == emptyKey) {
+            keys_[slot] = key;
+            values_[slot] = candidate;
+            size_++;
+        }
+        else if (candidate.betterThan(values_[slot])) {
+            values_[slot] = candidate;
+        }
+    }
+
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t slot = 0; slot < keys_.size(); slot++) {
+            if (keys_[slot] != emptyKey) {
+                f(keys_[slot], values_[slot]);
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t emptyKey = ~uint64_t(0);    // les cls n'utilisent que 63 bits
+
+    void grow() {
+        std::vector<uint64_t> keys;
+        std::vector<VoxelCandidate> values;
+        keys.swap(keys_);
+        values.swap(values_);
+        reset(keys.size());
+        for (size_t slot = 0; slot < keys.size(); slot++) {
+            if (keys[slot] != emptyKey) {
+                insert(keys[slot], values[slot]);
+            }
+        }
+    }
+
+    std::vector<uint64_t> keys_;
+    std::vector<VoxelCandidate> values_;
+    size_t size_ = 0;
+    int shift_ = 60;
+};
+
+// Nombre de voxels occups par les sommets chantillonns
+size_t occupiedVoxels(const VertexView& vertices, const std::vector<uint32_t>& sample, const cv::Point3f& origin,
+    float size, VoxelTable& table) {
+    float inverseSize = 1.f / size;
+    table.reset(table.size());
+    for (uint32_t index : sample) {
+        table.insert(voxelKey(vertices[index], origin, inverseSize), VoxelCandidate{ 0.f, index });
+    }
+    return table.size();
+}
+}
+
+BoundingBox computeBoundingBox(const VertexView& vertices) {
+    const float inf = std::numeric_limits<float>::max();
+    BoundingBox bounds;
+    bounds.min = cv::Point3f(inf, inf, inf);
+    bounds.max = cv::Point3f(-inf, -inf, -inf);
+
+    // OpenMP 2.0 (MSVC) n'a pas de rduction min/max: une bote par thread
+    std::vector<BoundingBox> partial(parallelThreadCount(), bounds);
+#pragma omp parallel
+    {
+        BoundingBox& local = partial[parallelThreadIndex()];
+#pragma omp for
+        for (long long i = 0; i < (long long)vertices.size(); i++) {
+            cv::Point3f p = vertices[i];
+            local.min.x = std::min(local.min.x, p.x);
+            local.min.y = std::min(local.min.y, p.y);
+            local.min.z = std::min(local.min.z, p.z);
+            local.max.x = std::max(local.max.x, p.x);
+            local.max.y = std::max(local.max.y, p.y);
+            local.max.z = std::max(local.max.z, p.z);
+        }
+    }
+
+    for (const BoundingBox& local : partial) {
+        bounds.min.x = std::min(bounds.min.x, local.min.x);
+        bounds.min.y = std::min(bounds.min.y, local.min.y);
+        bounds.min.z = std::min(bounds.min.z, local.min.z);
+        bounds.max.x = std::max(bounds.max.x, local.max.x);
+        bounds.max.y = std::max(bounds.max.y, local.max.y);
+        bounds.max.z = std::max(bounds.max.z, local.max.z);
+    }
+    return bounds;
+}
+
+SpatialGrid SpatialGrid::build(const VertexView& vertices, const BoundingBox& bounds, float verticesPerCell) {
+    CV_Assert(vertices.size() < std::numeric_limits<uint32_t>::max());
+
+    SpatialGrid grid;
+    grid.origin_ = bounds.min;
+
+    double targetCells = std::min<double>((double)maxGridCells, vertices.size() / verticesPerCell);
+    grid.cellSize_ = chooseLayout(bounds, targetCells, grid.dims_);
+
+    // Cellule de chaque sommet, puis tri par dnombrement
+    std::vector<uint32_t> vertexCell(vertices.size());
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)vertices.size(); i++) {
+        int cx, cy, cz;
+        grid.cellCoords(vertices[i], cx, cy, cz);
+        vertexCell[i] = (uint32_t)grid.cellIndex(cx, cy, cz);
+    }
+
+    grid.ownedCellStart_.assign(grid.cellCount() + 1, 0);
+    for (uint32_t cell : vertexCell) {
+        grid.ownedCellStart_[cell + 1]++;
+    }
+    for (size_t c = 0; c < grid.cellCount(); c++) {
+        grid.ownedCellStart_[c + 1] += grid.ownedCellStart_[c];
+    }
+
+    std::vector<uint32_t> cursor(grid.ownedCellStart_.begin(), grid.ownedCellStart_.end() - 1);
+    grid.ownedIndices_.resize(vertices.size());
+    for (size_t i = 0; i < vertexCell.size(); i++) {
+        grid.ownedIndices_[cursor[vertexCell[i]]++] = (uint32_t)i;
+    }
+
+    grid.cellStart_ = grid.ownedCellStart_.data();
+    grid.indices_ = grid.ownedIndices_.data();
+    return grid;
+}
+
+float SpatialGrid::chooseLayout(const BoundingBox& bounds, double targetCells, int dims[3]) {
+    // Les axes quasi plats gardent une paisseur minimale pour ne pas annuler le volume
+    cv::Point3f extent = bounds.size();
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    if (!(maxExtent > 0.f)) {
+        maxExtent = 1.f;
+    }
+    double minExtent = maxExtent / maxGridDim;
+    double volume = std::max<double>(extent.x, minExtent) * std::max<double>(extent.y, minExtent) *
+        std::max<double>(extent.z, minExtent);
+    targetCells = std::max(1.0, std::min<double>((double)maxGridCells, targetCells));
+    float cellSize = (float)std::cbrt(volume / targetCells);
+    if (!(cellSize > 0.f)) {
+        cellSize = maxExtent;
+    }
+
+    const float* extents[3] = { &extent.x, &extent.y, &extent.z };
+    for (;;) {
+        for (int axis = 0; axis < 3; axis++) {
+            int dim = (int)std::ceil(*extents[axis] / cellSize);
+            dims[axis] = std::max(1, std::min(maxGridDim, dim));
+        }
+        if ((size_t)dims[0] * dims[1] * dims[2] <= maxGridCells) {
+            break;
+        }
+        cellSize *= 1.26f;
+    }
+    return cellSize;
+}
+
+SpatialGrid SpatialGrid::fromArrays(const cv::Point3f& origin, float cellSize, const int dims[3],
+    const uint32_t* cellStart, const uint32_t* indices) {
+    SpatialGrid grid;
+    grid.origin_ = origin;
+    grid.cellSize_ = cellSize;
+    grid.dims_[0] = dims[0];
+    grid.dims_[1] = dims[1];
+    grid.dims_[2] = dims[2];
+    grid.cellStart_ = cellStart;
+    grid.indices_ = indices;
+    return grid;
+}
+
+void SpatialGrid::cellCoords(const cv::Point3f& p, int& cx, int& cy, int& cz) const {
+    // Bornage en flottant avant la conversion (points loigns de la grille)
+    float inv = 1.f / cellSize_;
+    cx = (int)std::max(0.f, std::min((float)(dims_[0] - 1), std::floor((p.x - origin_.x) * inv)));
+    cy = (int)std::max(0.f, std::min((float)(dims_[1] - 1), std::floor((p.y - origin_.y) * inv)));
+    cz = (int)std::max(0.f, std::min((float)(dims_[2] - 1), std::floor((p.z - origin_.z) * inv)));
+}
+
+std::vector<uint32_t> voxelSampleIndices(const VertexView& vertices, size_t targetCount) {
+    CV_Assert(vertices.size() < std::numeric_limits<uint32_t>::max());
+    std::vector<uint32_t> indices;
+    if (vertices.size() == 0 || targetCount == 0) {
+        return indices;
+    }
+    if (targetCount >= vertices.size()) {
+        indices.resize(vertices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            indices[i] = (uint32_t)i;
+        }
+        return indices;
+    }
+
+    BoundingBox bounds = computeBoundingBox(vertices);
+    cv::Point3f extent = bounds.size();
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    if (!(maxExtent > 0.f)) {
+        indices.push_back(0);
+        return indices;
+    }
+
+    // Taille des voxels par dichotomie (chelle logarithmique) sur un
+    // sous-chantillon rgulier: le nombre de voxels occups dpend de la
+    // forme du modle (surface, nuage volumique), pas seulement de son volume
+    size_t sampleCount = std::min(vertices.size(), std::max<size_t>(targetCount * voxelEstimationSamples, 50000));
+    std::vector<uint32_t> sample(sampleCount);
+    for (size_t i = 0; i < sampleCount; i++) {
+        sample[i] = (uint32_t)(i * vertices.size() / sampleCount);
+    }
+    VoxelTable counter(targetCount);
+    float small = maxExtent / (float)(1 << 20), large = maxExtent;
+    for (int iteration = 0; iteration < voxelSearchIterations; iteration++) {
+        float size = std::sqrt(small * large);
+        if (occupiedVoxels(vertices, sample, bounds.min, size, counter) > targetCount) {
+            small = size;
+        }
+        else {
+            large = size;
+        }
+    }
+    const float size = large;
+    const float inverseSize = 1.f / size;
+
+    // Un reprsentant par voxel: une table par thread, fusionnes ensuite
+    std::vector<VoxelTable> partial(parallelThreadCount());
+#pragma omp parallel
+    {
+        VoxelTable& local = partial[parallelThreadIndex()];
+        local.reset(counter.size());
+#pragma omp for
+        for (long long i = 0; i < (long long)vertices.size(); i++) {
+            cv::Point3f p = vertices[i];
+            uint64_t key = voxelKey(p, bounds.min, inverseSize);
+            cv::Point3f center = bounds.min + cv::Point3f((float)(key & 0x1FFFFF) + 0.5f,
+                (float)((key >> 21) & 0x1FFFFF) + 0.5f, (float)(key >> 42) + 0.5f) * size;
+            cv::Point3f d = p - center;
+            local.insert(key, VoxelCandidate{ d.dot(d), (uint32_t)i });
+        }
+    }
+
+    VoxelTable& merged = partial[0];
+    for (size_t t = 1; t < partial.size(); t++) {
+        partial[t].forEach([&merged](uint64_t key, const VoxelCandidate& candidate) {
+            merged.insert(key, candidate);
+        });
+    }
+
+    indices.reserve(merged.size());
+    merged.forEach([&indices](uint64_t, const VoxelCandidate& candidate) {
+        indices.push_back(candidate.index);
+    });
+    std::sort(indices.begin(), indices.end());
+
+    // Le sous-chantillon peut sous-estimer les voxels occups: rduction 
+    // pas rgulier dans l'ordre des indices
+    if (indices.size() > targetCount) {
+        for (size_t k = 0; k < targetCount; k++) {
+            indices[k] = indices[k * indices.size() / targetCount];
+        }
+        indices.resize(targetCount);
+    }
+    return indices;
+}
+
+std::vector<uint32_t> farthestPointSampleIndices(const VertexView& vertices, size_t count, size_t candidatesPerSample) {
+    std::vector<uint32_t> candidates;
+    if (vertices.size() > count * candidatesPerSample) {
+        candidates = voxelSampleIndices(vertices, count * candidatesPerSample);
+    }
+    else {
+        candidates.resize(vertices.size());
+        for (size_t i = 0; i < candidates.size(); i++) {
+            candidates[i] = (uint32_t)i;
+        }
+    }
+    if (count >= candidates.size()) {
+        return candidates;
+    }
+
+    // Candidats rangs par composante, distance au plus proche sommet retenu
+    const long long n = (long long)candidates.size();
+    std::vector<float> x(n), y(n), z(n), distance(n, std::numeric_limits<float>::max());
+    cv::Point3f centroid(0.f, 0.f, 0.f);
+    for (long long i = 0; i < n; i++) {
+        cv::Point3f p = vertices[candidates[i]];
+        x[i] = p.x;
+        y[i] = p.y;
+        z[i] = p.z;
+        centroid += p * (1.f / n);
+    }
+
+    // Dpart: le candidat le plus loign du centre (un point extrme)
+    long long first = 0;
+    float firstDistance = -1.f;
+    for (long long i = 0; i < n; i++) {
+        float dx = x[i] - centroid.x, dy = y[i] - centroid.y, dz = z[i] - centroid.z;
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > firstDistance) {
+            firstDistance = d;
+            first = i;
+        }
+    }
+
+    struct Farthest {
+        float distance;
+        long long index;
+    };
+    std::vector<Farthest> partial(parallelThreadCount(), Farthest{ -1.f, 0 });
+    std::vector<long long> selected;
+    selected.reserve(count);
+    selected.push_back(first);
+#pragma omp parallel
+    {
+        const int thread = parallelThreadIndex();
+        for (size_t k = 1; k < count; k++) {
+            const long long last = selected[k - 1];
+            const float px = x[last], py = y[last], pz = z[last];
+
+            // Mise  jour sans branche (vectorise), puis recherche du maximum
+            // sur la mme tranche (ordonnancement statique identique)
+#pragma omp for schedule(static) nowait
+            for (long long i = 0; i < n; i++) {
+                float dx = x[i] - px, dy = y[i] - py, dz = z[i] - pz;
+                distance[i] = std::min(distance[i], dx * dx + dy * dy + dz * dz);
+            }
+            Farthest local = { -1.f, 0 };
+#pragma omp for schedule(static)
+            for (long long i = 0; i < n; i++) {
+                if (distance[i] > local.distance) {
+                    local.distance = distance[i];
+                    local.index = i;
+                }
+            }
+            partial[thread] = local;
+#pragma omp barrier
+#pragma omp single
+            {
+                //  galit le plus petit indice: rsultat indpendant du nombre de threads
+                Farthest best = { -1.f, 0 };
+                for (const Farthest& candidate : partial) {
+                    if (candidate.distance > best.distance ||
+                        (candidate.distance == best.distance && candidate.index < best.index)) {
+                        best = candidate;
+                    }
+                }
+                selected.push_back(best.index);
+                for (Farthest& candidate : partial) {
+                    candidate.distance = -1.f;
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> indices(selected.size());
+    for (size_t k = 0; k < selected.size(); k++) {
+        indices[k] = candidates[selected[k]];
+    }
+    return indices;
+}
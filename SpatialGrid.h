@@ -0,0 +1,98 @@
+#pragma once
+
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+struct BoundingBox {
+    cv::Point3f min;
+    cv::Point3f max;
+
+    cv::Point3f size() const { return max - min; }
+    cv::Point3f center() const { return (min + max) * 0.5f; }
+};
+
+// Bote englobante des sommets (rduction parallle)
+BoundingBox computeBoundingBox(const VertexView& vertices);
+
+// Au plus targetCount sommets (en gnral un peu moins) rpartis uniformment
+// dans l'espace: un par voxel occup (le plus proche du centre du voxel), la
+// taille des voxels tant ajuste sur un sous-chantillon. Si l'estimation a
+// sous-valu le nombre de voxels, le rsultat est rduit  pas rgulier.
+// Temps linaire, indices croissants.
+std::vector<uint32_t> voxelSampleIndices(const VertexView& vertices, size_t targetCount);
+
+// count sommets aussi carts que possible (chantillonnage du point le plus
+// loign), dans l'ordre du choix: chacun est le plus loin des prcdents. Les
+// candidats sont pr-chantillonns par voxels (candidatesPerSample par sommet
+// retenu) pour que les distances restent en cache; la mise  jour des
+// distances est parallle et vectorisable.
+std::vector<uint32_t> farthestPointSampleIndices(const VertexView& vertices, size_t count,
+    size_t candidatesPerSample = 64);
+
+// Grille rgulire sur la bote englobante. Les indices de sommets sont tris
+// par cellule: les sommets de la cellule c sont indices[cellStart[c] .. cellStart[c+1]).
+// La grille possde ses tableaux aprs build(), ou les rfrence (cache projet
+// en mmoire) aprs fromArrays().
+class SpatialGrid {
+public:
+    SpatialGrid() = default;
+    SpatialGrid(SpatialGrid&&) = default;
+    SpatialGrid& operator=(SpatialGrid&&) = default;
+    SpatialGrid(const SpatialGrid&) = delete;
+    SpatialGrid& operator=(const SpatialGrid&) = delete;
+
+    // verticesPerCell: occupation moyenne vise pour une rpartition uniforme
+    static SpatialGrid build(const VertexView& vertices, const BoundingBox& bounds, float verticesPerCell = 8.f);
+    static SpatialGrid fromArrays(const cv::Point3f& origin, float cellSize, const int dims[3],
+        const uint32_t* cellStart, const uint32_t* indices);
+
+    // Taille de cellule et dimensions pour environ targetCells cellules sur la bote
+    static float chooseLayout(const BoundingBox& bounds, double targetCells, int dims[3]);
+
+    bool empty() const { return cellStart_ == nullptr; }
+    const cv::Point3f& origin() const { return origin_; }
+    float cellSize() const { return cellSize_; }
+    int dim(int axis) const { return dims_[axis]; }
+    size_t cellCount() const { return (size_t)dims_[0] * dims_[1] * dims_[2]; }
+    size_t indexCount() const { return empty() ? 0 : cellStart_[cellCount()]; }
+    const uint32_t* cellStart() const { return cellStart_; }
+    const uint32_t* indices() const { return indices_; }
+
+    // Coordonnes de cellule d'un point (bornes  la grille)
+    void cellCoords(const cv::Point3f& p, int& cx, int& cy, int& cz) const;
+    size_t cellIndex(int cx, int cy, int cz) const { return ((size_t)cz * dims_[1] + cy) * dims_[0] + cx; }
+
+    // Appelle f(indiceSommet) pour tous les sommets des cellules touchant la
+    // sphre (p, radius). Le filtrage exact par distance est laiss  l'appelant.
+    template <typename F>
+    void forEachNear(const cv::Point3f& p, float radius, F f) const {
+        if (empty()) {
+            return;
+        }
+        int x0, y0, z0, x1, y1, z1;
+        cellCoords(p - cv::Point3f(radius, radius, radius), x0, y0, z0);
+        cellCoords(p + cv::Point3f(radius, radius, radius), x1, y1, z1);
+        for (int cz = z0; cz <= z1; cz++) {
+            for (int cy = y0; cy <= y1; cy++) {
+                for (int cx = x0; cx <= x1; cx++) {
+                    size_t cell = cellIndex(cx, cy, cz);
+                    for (uint32_t k = cellStart_[cell]; k < cellStart_[cell + 1]; k++) {
+                        f(indices_[k]);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    cv::Point3f origin_;
+    float cellSize_ = 1.f;
+    int dims_[3] = { 0, 0, 0 };
+    const uint32_t* cellStart_ = nullptr;
+    const uint32_t* indices_ = nullptr;
+    std::vector<uint32_t> ownedCellStart_;
+    std::vector<uint32_t> ownedIndices_;
+};
@@ -0,0 +1,351 @@
+#include "TiledVertexStore.h"
+#include "MeshCache.h"
+#include "Parallel.h"
+#include "Projection.h"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <system_error>
+#include <type_traits>
+
+namespace {
+
+const char tilesMagic[8] = { 'S', 'P', 'N', 'P', 'T', 'I', 'L', '\0' };
+const uint32_t tilesVersion = 1;
+const size_t tileWriteBuffer = 4096;    // sommets par tampon d'criture de tuile
+
+struct TilesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t tileCount;
+    uint64_t vertexCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct TileRecord {
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t offset;
+    uint64_t count;
+};
+static_assert(std::is_trivially_copyable<TilesHeader>::value && std::is_trivially_copyable<TileRecord>::value,
+    "Les en-ttes de tuiles doivent rester des POD");
+
+BoundingBox emptyBounds() {
+    const float inf = std::numeric_limits<float>::max();
+    BoundingBox bounds;
+    bounds.min = cv::Point3f(inf, inf, inf);
+    bounds.max = cv::Point3f(-inf, -inf, -inf);
+    return bounds;
+}
+
+void extend(BoundingBox& bounds, const cv::Point3f& p) {
+    bounds.min.x = std::min(bounds.min.x, p.x);
+    bounds.min.y = std::min(bounds.min.y, p.y);
+    bounds.min.z = std::min(bounds.min.z, p.z);
+    bounds.max.x = std::max(bounds.max.x, p.x);
+    bounds.max.y = std::max(bounds.max.y, p.y);
+    bounds.max.z = std::max(bounds.max.z, p.z);
+}
+
+} // namespace
+
+std::string TiledVertexStore::tilesPath(const std::string& plyPath) {
+    return plyPath + ".spnptiles";
+}
+
+bool TiledVertexStore::build(const std::string& plyPath, const VertexView& vertices, size_t verticesPerTile) {
+    SourceIdentity identity;
+    if (!readSourceIdentity(plyPath, identity) || vertices.empty()) {
+        return false;
+    }
+
+    BoundingBox bounds = computeBoundingBox(vertices);
+    int dims[3];
+    double targetTiles = std::ceil((double)vertices.size() / std::max<size_t>(1, verticesPerTile));
+    float cellSize = SpatialGrid::chooseLayout(bounds, targetTiles, dims);
+    SpatialGrid layout = SpatialGrid::fromArrays(bounds.min, cellSize, dims, nullptr, nullptr);
+    size_t cellCount = layout.cellCount();
+
+    // Passe 1: effectif et bote de chaque cellule, un jeu de compteurs par thread
+    int threadCount = parallelThreadCount();
+    std::vector<uint64_t> threadCounts((size_t)threadCount * cellCount, 0);
+    std::vector<BoundingBox> threadBounds((size_t)threadCount * cellCount, emptyBounds());
+#pragma omp parallel
+    {
+        size_t base = (size_t)parallelThreadIndex() * cellCount;
+#pragma omp for
+        for (long long i = 0; i < (long long)vertices.size(); i++) {
+            cv::Point3f p = vertices[i];
+            int cx, cy, cz;
+            layout.cellCoords(p, cx, cy, cz);
+            size_t cell = base + layout.cellIndex(cx, cy, cz);
+            threadCounts[cell]++;
+            extend(threadBounds[cell], p);
+        }
+    }
+
+    // Seules les cellules non vides deviennent des tuiles
+    std::vector<TileRecord> records;
+    std::vector<int64_t> tileOfCell(cellCount, -1);
+    uint64_t dataOffset = sizeof(TilesHeader);
+    for (size_t c = 0; c < cellCount; c++) {
+        uint64_t count = 0;
+        BoundingBox tileBounds = emptyBounds();
+        for (int t = 0; t < threadCount; t++) {
+            size_t k = (size_t)t * cellCount + c;
+            count += threadCounts[k];
+            if (threadCounts[k] > 0) {
+                extend(tileBounds, threadBounds[k].min);
+                extend(tileBounds, threadBounds[k].max);
+            }
+        }
+        if (count > 0) {
+            TileRecord record = {};
+            record.boundsMin[0] = tileBounds.min.x; record.boundsMin[1] = tileBounds.min.y; record.boundsMin[2] = tileBounds.min.z;
+            record.boundsMax[0] = tileBounds.max.x; record.boundsMax[1] = tileBounds.max.y; record.boundsMax[2] = tileBounds.max.z;
+            record.count = count;
+            tileOfCell[c] = (int64_t)records.size();
+            records.push_back(record);
+        }
+    }
+    dataOffset += records.size() * sizeof(TileRecord);
+    for (TileRecord& record : records) {
+        record.offset = dataOffset;
+        dataOffset += record.count * sizeof(cv::Point3f);
+    }
+
+    std::string path = tilesPath(plyPath);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        TilesHeader header = {};
+        std::memcpy(header.magic, tilesMagic, sizeof(tilesMagic));
+        header.version = tilesVersion;
+        header.tileCount = records.size();
+        header.vertexCount = vertices.size();
+        header.sourceSize = identity.size;
+        header.sourceTime = identity.time;
+        header.sourceHash = identity.hash;
+        header.boundsMin[0] = bounds.min.x; header.boundsMin[1] = bounds.min.y; header.boundsMin[2] = bounds.min.z;
+        header.boundsMax[0] = bounds.max.x; header.boundsMax[1] = bounds.max.y; header.boundsMax[2] = bounds.max.z;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TileRecord));
+
+        // Passe 2: rpartition des sommets, un petit tampon par tuile vid  sa place dans le fichier
+        std::vector<std::vector<cv::Point3f>> buffers(records.size());
+        std::vector<uint64_t> written(records.size(), 0);
+        auto flush = [&](size_t tile) {
+            std::vector<cv::Point3f>& buffer = buffers[tile];
+            out.seekp((std::streamoff)(records[tile].offset + written[tile] * sizeof(cv::Point3f)));
+            out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(cv::Point3f));
+            written[tile] += buffer.size();
+            buffer.clear();
+        };
+        for (size_t i = 0; i < vertices.size(); i++) {
+            cv::Point3f p = vertices[i];
+            int cx, cy, cz;
+            layout.cellCoords(p, cx, cy, cz);
+            size_t tile = (size_t)tileOfCell[layout.cellIndex(cx, cy, cz)];
+            buffers[tile].push_back(p);
+            if (buffers[tile].size() >= tileWriteBuffer) {
+                flush(tile);
+            }
+        }
+        for (size_t tile = 0; tile < records.size(); tile++) {
+            if (!buffers[tile].empty()) {
+                flush(tile);
+            }
+        }
+        if (!out) {
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool TiledVertexStore::open(const std::string& plyPath, size_t cacheBytes) {
+    std::string path = tilesPath(plyPath);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        return false;
+    }
+
+    SourceIdentity identity;
+    if (!readSourceIdentity(plyPath, identity)) {
+        return false;
+    }
+
+    MappedFile file;
+    try {
+        file = MappedFile(path);
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+
+    TilesHeader header;
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, tilesMagic, sizeof(tilesMagic)) != 0 || header.version != tilesVersion ||
+        header.sourceSize != identity.size || header.sourceTime != identity.time || header.sourceHash != identity.hash) {
+        return false;
+    }
+    if (header.tileCount > (file.size() - sizeof(header)) / sizeof(TileRecord)) {
+        return false;
+    }
+
+    std::vector<TileInfo> tiles(header.tileCount);
+    uint64_t total = 0;
+    for (size_t t = 0; t < tiles.size(); t++) {
+        TileRecord record;
+        std::memcpy(&record, file.data() + sizeof(header) + t * sizeof(TileRecord), sizeof(record));
+        if (record.count == 0 || record.offset > file.size() ||
+            record.count > (file.size() - record.offset) / sizeof(cv::Point3f)) {
+            return false;
+        }
+        tiles[t].bounds.min = cv::Point3f(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+        tiles[t].bounds.max = cv::Point3f(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+        tiles[t].offset = record.offset;
+        tiles[t].count = record.count;
+        total += record.count;
+    }
+    if (total != header.vertexCount) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    path_ = path;
+    vertexCount_ = header.vertexCount;
+    bounds_.min = cv::Point3f(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    bounds_.max = cv::Point3f(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    tiles_ = std::move(tiles);
+    cacheBytes_ = cacheBytes;
+    cachedBytes_ = 0;
+    recentTiles_.clear();
+    cachedTiles_.clear();
+    return true;
+}
+
+std::shared_ptr<const TiledVertexStore::Tile> TiledVertexStore::tile(size_t index) {
+    CV_Assert(index < tiles_.size());
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+
+    auto cached = cachedTiles_.find(index);
+    if (cached != cachedTiles_.end()) {
+        recentTiles_.splice(recentTiles_.begin(), recentTiles_, cached->second.second);
+        return cached->second.first;
+    }
+
+    const TileInfo& info = tiles_[index];
+    size_t bytes = (size_t)(info.count * sizeof(cv::Point3f));
+    auto tile = std::make_shared<Tile>();
+    tile->file = MappedFile(path_, info.offset, bytes);
+    tile->vertices = VertexView(tile->file.data(), (size_t)info.count);
+
+    recentTiles_.push_front(index);
+    cachedTiles_[index] = std::make_pair(std::shared_ptr<const Tile>(tile), recentTiles_.begin());
+    cachedBytes_ += bytes;
+
+    // viction des tuiles les plus anciennes (la tuile demande reste)
+    while (cachedBytes_ > cacheBytes_ && recentTiles_.size() > 1) {
+        size_t oldest = recentTiles_.back();
+        recentTiles_.pop_back();
+        cachedBytes_ -= (size_t)(tiles_[oldest].count * sizeof(cv::Point3f));
+        cachedTiles_.erase(oldest);
+    }
+    return tile;
+}
+
+std::vector<cv::Point3f> TiledVertexStore::sample(size_t sampleCount) {
+    std::vector<cv::Point3f> result;
+    if (vertexCount_ == 0 || sampleCount == 0) {
+        return result;
+    }
+    result.reserve(sampleCount + tiles_.size());
+
+    // Quota de chaque tuile au prorata de son effectif (reste cumul pour ne
+    // pas perdre les petites tuiles  l'arrondi)
+    double share = (double)sampleCount / vertexCount_;
+    double pending = 0.0;
+    for (size_t t = 0; t < tiles_.size(); t++) {
+        pending += tiles_[t].count * share;
+        size_t quota = (size_t)pending;
+        if (quota == 0) {
+            continue;
+        }
+        pending -= quota;
+        quota = std::min<size_t>(quota, (size_t)tiles_[t].count);
+
+        std::shared_ptr<const Tile> loaded = tile(t);
+        VertexView picked = loaded->vertices.subsample((size_t)tiles_[t].count / quota);
+        for (size_t i = 0; i < picked.size() && i < quota; i++) {
+            result.push_back(picked[i]);
+        }
+    }
+    return result;
+}
+
+void TiledVertexStore::projectVisible(const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix,
+    const cv::Mat& distCoeffs, size_t maxPoints, std::vector<cv::Point2f>& imagePoints) {
+    imagePoints.clear();
+
+    // Seule la profondeur dans le repre camra compte: dernire ligne de R et tz
+    cv::Mat rotation, translation;
+    cv::Rodrigues(rvec, rotation);
+    rotation.convertTo(rotation, CV_64F);
+    tvec.convertTo(translation, CV_64F);
+    double r0 = rotation.at<double>(2, 0), r1 = rotation.at<double>(2, 1), r2 = rotation.at<double>(2, 2);
+    double tz = translation.at<double>(2);
+
+    // Une tuile est garde si au moins un coin de sa bote est devant la camra
+    std::vector<size_t> visible;
+    uint64_t visibleCount = 0;
+    for (size_t i = 0; i < tiles_.size(); i++) {
+        const BoundingBox& box = tiles_[i].bounds;
+        bool inFront = false;
+        for (int corner = 0; corner < 8 && !inFront; corner++) {
+            double x = (corner & 1) ? box.max.x : box.min.x;
+            double y = (corner & 2) ? box.max.y : box.min.y;
+            double z = (corner & 4) ? box.max.z : box.min.z;
+            inFront = r0 * x + r1 * y + r2 * z + tz > 0.0;
+        }
+        if (inFront) {
+            visible.push_back(i);
+            visibleCount += tiles_[i].count;
+        }
+    }
+
+    size_t step = std::max<size_t>(1, (size_t)(visibleCount / std::max<size_t>(1, maxPoints)));
+    std::vector<cv::Point2f> projectedTile;
+    for (size_t i : visible) {
+        std::shared_ptr<const Tile> loaded = tile(i);
+        projectVertices(loaded->vertices.subsample(step), rvec, tvec, cameraMatrix, distCoeffs, projectedTile);
+        imagePoints.insert(imagePoints.end(), projectedTile.begin(), projectedTile.end());
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "SpatialGrid.h"
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stockage hors mmoire des sommets pour les trs gros relevs (au-del du
+// milliard de points). Les sommets sont rpartis en tuiles spatiales crites
+// dans "<fichier>.spnptiles"; chaque tuile est contigu sur le disque et
+// projete en mmoire seulement quand on l'interroge. Les tuiles rcemment
+// utilises restent projetes dans un cache LRU de taille borne.
+class TiledVertexStore {
+public:
+    struct TileInfo {
+        BoundingBox bounds;
+        uint64_t offset = 0;    // position des sommets (cv::Point3f) dans le fichier
+        uint64_t count = 0;
+    };
+
+    // Tuile projete en mmoire. Elle reste valide tant que le pointeur est
+    // gard, mme si le cache l'a vince entre-temps.
+    struct Tile {
+        MappedFile file;
+        VertexView vertices;
+    };
+
+    static std::string tilesPath(const std::string& plyPath);
+
+    // Rpartit les sommets en tuiles d'environ verticesPerTile sommets.
+    // Retourne false si le fichier ne peut pas tre crit.
+    static bool build(const std::string& plyPath, const VertexView& vertices, size_t verticesPerTile = 1 << 20);
+
+    // Ouvre les tuiles de plyPath. Retourne false si elles n'existent pas ou
+    // si le PLY a chang depuis leur criture.
+    bool open(const std::string& plyPath, size_t cacheBytes = size_t(1) << 30);
+
+    bool isOpen() const { return !path_.empty(); }
+    uint64_t vertexCount() const { return vertexCount_; }
+    const BoundingBox& bounds() const { return bounds_; }
+    size_t tileCount() const { return tiles_.size(); }
+
+    // Tuile index, projete  la demande (utilisable depuis plusieurs threads)
+    std::shared_ptr<const Tile> tile(size_t index);
+
+    // Environ sampleCount sommets rpartis sur toutes les tuiles, au prorata
+    // de leur taille
+    std::vector<cv::Point3f> sample(size_t sampleCount);
+
+    // Projection d'environ maxPoints sommets rpartis sur les tuiles devant la
+    // camra; les tuiles entirement derrire elle ne sont pas lues.
+    void projectVisible(const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix,
+        const cv::Mat& distCoeffs, size_t maxPoints, std::vector<cv::Point2f>& imagePoints);
+
+private:
+    std::string path_;
+    uint64_t vertexCount_ = 0;
+    BoundingBox bounds_;
+    std::vector<TileInfo> tiles_;
+
+    size_t cacheBytes_ = 0;
+    size_t cachedBytes_ = 0;
+    std::mutex cacheMutex_;
+    std::list<size_t> recentTiles_;    // du plus rcent au plus ancien
+    std::unordered_map<size_t, std::pair<std::shared_ptr<const Tile>, std::list<size_t>::iterator>> cachedTiles_;
+};
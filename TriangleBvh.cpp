@@ -0,0 +1,329 @@
+#include "TriangleBvh.h"
+#include "PlyReader.h"
+
+#include <opencv2/calib3d.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const int binCount = 16;
+const uint32_t maxLeafTriangles = 4;
+const float traversalCost = 1.0f;    // relativement  un test rayon-triangle
+
+struct Box {
+    cv::Point3f min = cv::Point3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+        std::numeric_limits<float>::max());
+    cv::Point3f max = cv::Point3f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+        -std::numeric_limits<float>::max());
+
+    void grow(const cv::Point3f& p) {
+        min.x = std::min(min.x, p.x); min.y = std::min(min.y, p.y); min.z = std::min(min.z, p.z);
+        max.x = std::max(max.x, p.x); max.y = std::max(max.y, p.y); max.z = std::max(max.z, p.z);
+    }
+    void grow(const Box& b) {
+        grow(b.min);
+        grow(b.max);
+    }
+    float area() const {
+        if (max.x < min.x) {
+            return 0.f;
+        }
+        cv::Point3f d = max - min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+inline float axisValue(const cv::Point3f& p, int axis) {
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+// Rayon-triangle (Mller-Trumbore), les deux faces. Retourne la distance ou -1.
+inline float intersectTriangle(const cv::Point3f& origin, const cv::Point3f& direction,
+    const cv::Point3f& p0, const cv::Point3f& p1, const cv::Point3f& p2) {
+    cv::Point3f e1 = p1 - p0, e2 = p2 - p0;
+    cv::Point3f pv = direction.cross(e2);
+    float det = e1.dot(pv);
+    if (std::abs(det) < 1e-12f) {
+        return -1.f;
+    }
+    float inv = 1.f / det;
+    cv::Point3f tv = origin - p0;
+    float u = tv.dot(pv) * inv;
+    if (u < 0.f || u > 1.f) {
+        return -1.f;
+    }
+    cv::Point3f qv = tv.cross(e1);
+    float v = direction.dot(qv) * inv;
+    if (v < 0.f || u + v > 1.f) {
+        return -1.f;
+    }
+    return e2.dot(qv) * inv;
+}
+}
+
+TriangleBvh TriangleBvh::build(const VertexView& vertices, const int* polygons, size_t polygonsSize,
+    const uint32_t* sourceFaces) {
+    TriangleBvh bvh;
+    bvh.vertices_ = vertices;
+    std::vector<cv::Vec3i> triangles;
+    std::vector<uint32_t> faces;
+    triangulatePolygons(polygons, polygonsSize, vertices.size(), triangles, faces, sourceFaces);
+    if (triangles.empty()) {
+        return bvh;
+    }
+    CV_Assert(triangles.size() < std::numeric_limits<uint32_t>::max());
+
+    // Bote et centre de chaque triangle
+    std::vector<Box> boxes(triangles.size());
+    std::vector<cv::Point3f> centers(triangles.size());
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)triangles.size(); i++) {
+        Box box;
+        for (int k = 0; k < 3; k++) {
+            box.grow(vertices[triangles[i][k]]);
+        }
+        boxes[i] = box;
+        centers[i] = (box.min + box.max) * 0.5f;
+    }
+
+    std::vector<uint32_t> order(triangles.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (uint32_t)i;
+    }
+
+    // Construction en profondeur avec une pile explicite: chaque entre est un
+    // noeud dj cr dont les triangles sont order[first, first + count)
+    struct Pending {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+    };
+    bvh.nodes_.reserve(2 * triangles.size() / maxLeafTriangles + 1);
+    bvh.nodes_.push_back(Node());
+    std::vector<Pending> stack;
+    stack.push_back({ 0, 0, (uint32_t)triangles.size() });
+    while (!stack.empty()) {
+        Pending item = stack.back();
+        stack.pop_back();
+
+        Box bounds, centerBounds;
+        for (uint32_t i = item.first; i < item.first + item.count; i++) {
+            bounds.grow(boxes[order[i]]);
+            centerBounds.grow(centers[order[i]]);
+        }
+        Node& node = bvh.nodes_[item.node];
+        node.min[0] = bounds.min.x; node.min[1] = bounds.min.y; node.min[2] = bounds.min.z;
+        node.max[0] = bounds.max.x; node.max[1] = bounds.max.y; node.max[2] = bounds.max.z;
+        node.offset = item.first;
+        node.count = item.count;
+        if (item.count <= maxLeafTriangles) {
+            continue;
+        }
+
+        // Meilleure coupe SAH parmi les frontires de classes des trois axes
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = item.count * bounds.area();
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = axisValue(centerBounds.min, axis), hi = axisValue(centerBounds.max, axis);
+            if (!(hi > lo)) {
+                continue;
+            }
+            float scale = binCount / (hi - lo);
+            Box binBoxes[binCount];
+            uint32_t binCounts[binCount] = {};
+            for (uint32_t i = item.first; i < item.first + item.count; i++) {
+                int bin = std::min(binCount - 1, (int)((axisValue(centers[order[i]], axis) - lo) * scale));
+                binBoxes[bin].grow(boxes[order[i]]);
+                binCounts[bin]++;
+            }
+            float rightArea[binCount];
+            uint32_t rightCount[binCount];
+            Box right;
+            uint32_t count = 0;
+            for (int b = binCount - 1; b > 0; b--) {
+                right.grow(binBoxes[b]);
+                count += binCounts[b];
+                rightArea[b] = right.area();
+                rightCount[b] = count;
+            }
+            Box left;
+            count = 0;
+            for (int b = 1; b < binCount; b++) {
+                left.grow(binBoxes[b - 1]);
+                count += binCounts[b - 1];
+                if (count == 0 || rightCount[b] == 0) {
+                    continue;
+                }
+                float cost = traversalCost * bounds.area() + count * left.area() + rightCount[b] * rightArea[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        uint32_t leftCount;
+        if (bestAxis >= 0) {
+            float lo = axisValue(centerBounds.min, bestAxis), hi = axisValue(centerBounds.max, bestAxis);
+            float scale = binCount / (hi - lo);
+            uint32_t* middle = std::partition(order.data() + item.first, order.data() + item.first + item.count,
+                [&](uint32_t t) {
+                    return std::min(binCount - 1, (int)((axisValue(centers[t], bestAxis) - lo) * scale)) < bestSplit;
+                });
+            leftCount = (uint32_t)(middle - (order.data() + item.first));
+        }
+        else {
+            // Centres confondus ou coupe sans gain: coupe au milieu, pour que
+            // les feuilles gardent au plus maxLeafTriangles triangles
+            leftCount = item.count / 2;
+        }
+
+        uint32_t child = (uint32_t)bvh.nodes_.size();
+        bvh.nodes_[item.node].offset = child;
+        bvh.nodes_[item.node].count = 0;
+        bvh.nodes_.push_back(Node());
+        bvh.nodes_.push_back(Node());
+        stack.push_back({ child + 1, item.first + leftCount, item.count - leftCount });
+        stack.push_back({ child, item.first, leftCount });
+    }
+
+    bvh.triangles_.resize(triangles.size());
+    bvh.faces_.resize(triangles.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        bvh.triangles_[i] = triangles[order[i]];
+        bvh.faces_[i] = faces.empty() ? order[i] : faces[order[i]];
+    }
+    return bvh;
+}
+
+RayHit TriangleBvh::intersect(const cv::Point3f& origin, const cv::Vec3f& direction) const {
+    std::vector<uint32_t> stack;
+    return intersect(origin, direction, stack);
+}
+
+void TriangleBvh::intersect(const cv::Point3f* origins, const cv::Vec3f* directions, size_t count, RayHit* hits) const {
+#pragma omp parallel
+    {
+        std::vector<uint32_t> stack;
+#pragma omp for schedule(dynamic, 256)
+        for (long long i = 0; i < (long long)count; i++) {
+            hits[i] = intersect(origins[i], directions[i], stack);
+        }
+    }
+}
+
+RayHit TriangleBvh::intersect(const cv::Point3f& origin, const cv::Vec3f& direction, std::vector<uint32_t>& stack) const {
+    RayHit result;
+    float length = std::sqrt(direction.dot(direction));
+    if (nodes_.empty() || !(length > 0.f)) {
+        return result;
+    }
+    cv::Point3f dir(direction[0] / length, direction[1] / length, direction[2] / length);
+    float o[3] = { origin.x, origin.y, origin.z };
+    float invDir[3] = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z };
+
+    // Entre du rayon dans la bote d'un noeud, ou infini s'il la manque
+    auto enter = [&](const Node& node) {
+        float tmin = 0.f, tmax = std::numeric_limits<float>::max();
+        for (int a = 0; a < 3; a++) {
+            float t0 = (node.min[a] - o[a]) * invDir[a];
+            float t1 = (node.max[a] - o[a]) * invDir[a];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            // Les NaN (rayon parallle sur une face de la bote) ne resserrent pas l'intervalle
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+        }
+        return tmin <= tmax ? tmin : std::numeric_limits<float>::infinity();
+    };
+
+    float best = std::numeric_limits<float>::max();
+    size_t bestTriangle = 0;
+    if (enter(nodes_[0]) == std::numeric_limits<float>::infinity()) {
+        return result;
+    }
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                const cv::Vec3i& t = triangles_[i];
+                float d = intersectTriangle(origin, dir, vertices_[t[0]], vertices_[t[1]], vertices_[t[2]]);
+                if (d > 0.f && d < best) {
+                    best = d;
+                    bestTriangle = i;
+                    result.hit = true;
+                }
+            }
+            continue;
+        }
+
+        // Enfant le plus proche en dernier sur la pile: visit d'abord
+        uint32_t closer = node.offset, further = node.offset + 1;
+        float tCloser = enter(nodes_[closer]), tFurther = enter(nodes_[further]);
+        if (tFurther < tCloser) {
+            std::swap(closer, further);
+            std::swap(tCloser, tFurther);
+        }
+        if (tFurther < best) {
+            stack.push_back(further);
+        }
+        if (tCloser < best) {
+            stack.push_back(closer);
+        }
+    }
+
+    if (result.hit) {
+        result.distance = best;
+        result.point = origin + dir * best;
+        result.face = faces_[bestTriangle];
+        const cv::Vec3i& t = triangles_[bestTriangle];
+        float nearest = std::numeric_limits<float>::max();
+        for (int k = 0; k < 3; k++) {
+            cv::Point3f d = vertices_[t[k]] - result.point;
+            if (d.dot(d) < nearest) {
+                nearest = d.dot(d);
+                result.nearestVertex = (size_t)t[k];
+            }
+        }
+    }
+    return result;
+}
+
+void backProjectPoints(const TriangleBvh& bvh, const std::vector<cv::Point2f>& imagePoints, const cv::Mat& rvec,
+    const cv::Mat& tvec, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<RayHit>& hits) {
+    hits.assign(imagePoints.size(), RayHit());
+    if (imagePoints.empty() || bvh.empty()) {
+        return;
+    }
+
+    // Coordonnes normalises sans distorsion: direction (x, y, 1) dans le repre camra
+    std::vector<cv::Point2f> normalized;
+    cv::undistortPoints(imagePoints, normalized, cameraMatrix, distCoeffs);
+
+    cv::Mat rotationMatrix, translation;
+    cv::Rodrigues(rvec, rotationMatrix);
+    rotationMatrix.convertTo(rotationMatrix, CV_64F);
+    tvec.convertTo(translation, CV_64F);
+    const double* r = rotationMatrix.ptr<double>();
+    const double* t = translation.ptr<double>();
+
+    // Centre optique dans le repre du modle: -R^T t; directions: R^T (x, y, 1)
+    cv::Point3f origin((float)-(r[0] * t[0] + r[3] * t[1] + r[6] * t[2]),
+        (float)-(r[1] * t[0] + r[4] * t[1] + r[7] * t[2]), (float)-(r[2] * t[0] + r[5] * t[1] + r[8] * t[2]));
+    std::vector<cv::Point3f> origins(normalized.size(), origin);
+    std::vector<cv::Vec3f> directions(normalized.size());
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)normalized.size(); i++) {
+        double x = normalized[i].x, y = normalized[i].y;
+        directions[i] = cv::Vec3f((float)(r[0] * x + r[3] * y + r[6]), (float)(r[1] * x + r[4] * y + r[7]),
+            (float)(r[2] * x + r[5] * y + r[8]));
+    }
+    bvh.intersect(origins.data(), directions.data(), directions.size(), hits.data());
+}
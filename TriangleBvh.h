@@ -0,0 +1,62 @@
+#pragma once
+
+#include "VertexView.h"
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RayHit {
+    bool hit = false;
+    float distance = 0.f;      // le long du rayon (direction normalise)
+    cv::Point3f point;
+    size_t face = 0;           // face d'origine (indice dans polygons, ou sourceFaces[indice])
+    size_t nearestVertex = 0;  // sommet du triangle touch le plus proche du point
+};
+
+// Hirarchie de botes englobantes sur les triangles du maillage, pour lancer
+// un rayon (clic dans la fentre 3D) et obtenir le point exact de la surface.
+// Construction par dcoupage SAH sur 16 classes, feuilles de 4 triangles au
+// plus; une requte ne visite que quelques dizaines de noeuds.
+class TriangleBvh {
+public:
+    TriangleBvh() = default;
+
+    // polygons au format cv::viz::Mesh::polygons. vertices doit rester valide.
+    // sourceFaces: voir triangulatePolygons (faces du PLY aprs soudure).
+    static TriangleBvh build(const VertexView& vertices, const int* polygons, size_t polygonsSize,
+        const uint32_t* sourceFaces = nullptr);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t triangleCount() const { return triangles_.size(); }
+
+    // Premier triangle touch par le rayon origin + t * direction, t > 0 (les
+    // deux cts des faces comptent)
+    RayHit intersect(const cv::Point3f& origin, const cv::Vec3f& direction) const;
+
+    // Mme requte pour un lot de rayons, rpartis entre les threads
+    void intersect(const cv::Point3f* origins, const cv::Vec3f* directions, size_t count, RayHit* hits) const;
+
+private:
+    struct Node {
+        float min[3];
+        float max[3];
+        uint32_t offset;    // noeud interne: premier enfant (le second suit); feuille: premier triangle
+        uint32_t count;     // nombre de triangles, 0 pour un noeud interne
+    };
+
+    VertexView vertices_;
+    std::vector<cv::Vec3i> triangles_;      // dans l'ordre des feuilles
+    std::vector<uint32_t> faces_;           // face d'origine de chaque triangle
+    std::vector<Node> nodes_;
+
+    // stack: pile de parcours rutilise d'un rayon  l'autre
+    RayHit intersect(const cv::Point3f& origin, const cv::Vec3f& direction, std::vector<uint32_t>& stack) const;
+};
+
+// Rtroprojection de points de l'image sur le maillage depuis une pose (rvec,
+// tvec, K et distorsion au format de cv::projectPoints): hits[i] est le point
+// de la surface vu au pixel imagePoints[i]. Les rayons sont lancs en parallle.
+void backProjectPoints(const TriangleBvh& bvh, const std::vector<cv::Point2f>& imagePoints, const cv::Mat& rvec,
+    const cv::Mat& tvec, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, std::vector<RayHit>& hits);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+// Vue non propritaire sur un tableau de sommets (coordonnes float).
+// Deux dispositions sont possibles:
+// - entrelace (x, y, z conscutifs), avec un pas entre sommets ventuellement
+//   suprieur  12 octets, ce qui permet de parcourir directement le bloc de
+//   sommets d'un PLY binaire projet en mmoire (normales, couleurs...);
+// - spare (un tableau par composante), comme dans le cache de maillage.
+// Tous les traitements (chantillonnage, slection, projection) travaillent sur
+// cette vue: les sommets du maillage ne sont jamais recopis en entier.
+class VertexView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = cv::Point3f;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const cv::Point3f*;
+        using reference = cv::Point3f;
+
+        Iterator() = default;
+        Iterator(const VertexView* view, size_t index) : view_(view), index_(index) {}
+
+        cv::Point3f operator*() const { return (*view_)[index_]; }
+        Iterator& operator++() { ++index_; return *this; }
+        Iterator operator++(int) { Iterator it = *this; ++index_; return it; }
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const VertexView* view_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    VertexView() = default;
+    VertexView(const void* data, size_t count, size_t stride = sizeof(cv::Point3f))
+        : VertexView(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + sizeof(float),
+            static_cast<const unsigned char*>(data) + 2 * sizeof(float), count, stride) {}
+    VertexView(const std::vector<cv::Point3f>& vertices)
+        : VertexView(vertices.data(), vertices.size()) {}
+
+    // Vue sur trois tableaux spars x[], y[], z[]
+    static VertexView fromComponents(const float* x, const float* y, const float* z, size_t count) {
+        return VertexView(reinterpret_cast<const unsigned char*>(x), reinterpret_cast<const unsigned char*>(y),
+            reinterpret_cast<const unsigned char*>(z), count, sizeof(float));
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    size_t stride() const { return stride_; }
+    const unsigned char* data() const { return x_; }
+    const unsigned char* componentData(int axis) const { return axis == 0 ? x_ : (axis == 1 ? y_ : z_); }
+    // Tableau de cv::Point3f utilisable tel quel: entrelac sans autre champ et
+    // align sur 4 octets (le bloc de sommets d'un PLY commence  la fin de
+    // l'en-tte,  une position quelconque)
+    bool isContiguous() const {
+        return isPacked() && reinterpret_cast<uintptr_t>(x_) % alignof(float) == 0;
+    }
+    bool isComponentArrays() const { return stride_ == sizeof(float); }
+
+    // Les donnes d'un fichier projet ne sont pas forcment alignes sur 4 octets:
+    // on passe par memcpy plutt que par un cast de pointeur.
+    cv::Point3f operator[](size_t i) const {
+        cv::Point3f p;
+        size_t offset = i * stride_;
+        std::memcpy(&p.x, x_ + offset, sizeof(float));
+        std::memcpy(&p.y, y_ + offset, sizeof(float));
+        std::memcpy(&p.z, z_ + offset, sizeof(float));
+        return p;
+    }
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, count_); }
+
+    // Un sommet sur "step", sans copie (le pas de la vue est multipli).
+    VertexView subsample(size_t step) const {
+        step = step < 1 ? 1 : step;
+        return VertexView(x_, y_, z_, (count_ + step - 1) / step, stride_ * step);
+    }
+
+    // Sommets [first, first + count), sans copie.
+    VertexView subview(size_t first, size_t count) const {
+        if (first >= count_) {
+            return VertexView(x_, y_, z_, 0, stride_);
+        }
+        count = count < count_ - first ? count : count_ - first;
+        size_t offset = first * stride_;
+        return VertexView(x_ + offset, y_ + offset, z_ + offset, count, stride_);
+    }
+
+    void copyTo(std::vector<cv::Point3f>& vertices) const {
+        vertices.resize(count_);
+        if (isPacked()) {
+            if (count_ > 0) {
+                std::memcpy(vertices.data(), x_, count_ * sizeof(cv::Point3f));
+            }
+            return;
+        }
+        for (size_t i = 0; i < count_; i++) {
+            vertices[i] = (*this)[i];
+        }
+    }
+
+    // En-tte cv::Mat 1xN CV_32FC3 sur les donnes (vue contigu uniquement,
+    // OpenCV lit les donnes comme des float). La matrice ne possde pas les
+    // donnes et ne doit pas tre modifie.
+    cv::Mat asMat() const {
+        CV_Assert(isContiguous());
+        return cv::Mat(1, (int)count_, CV_32FC3, const_cast<unsigned char*>(x_));
+    }
+
+private:
+    // x, y, z conscutifs sans autre champ (memcpy possible, mme non align)
+    bool isPacked() const {
+        return stride_ == sizeof(cv::Point3f) && y_ == x_ + sizeof(float) && z_ == x_ + 2 * sizeof(float);
+    }
+
+    VertexView(const unsigned char* x, const unsigned char* y, const unsigned char* z, size_t count, size_t stride)
+        : x_(x), y_(y), z_(z), count_(count), stride_(stride) {}
+
+    const unsigned char* x_ = nullptr;
+    const unsigned char* y_ = nullptr;
+    const unsigned char* z_ = nullptr;
+    size_t count_ = 0;
+    size_t stride_ = sizeof(cv::Point3f);
+};